@@ -0,0 +1,290 @@
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+#include <cstdlib>
+
+#include "VulkanInstance.hh"
+#include "RenderAssets.hh"
+#include "VertexRenderer.hh"
+#include "Structs.hh"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+// drives Renderer::drawFrame headless for a fixed number of frames
+// and prints cpu frame time and per pass gpu time statistics as json to stdout
+//
+// usage: reimp-bench [--frames N] [--warmup N] [--width W] [--height H] [--validation]
+//                    [--frames-in-flight N] [--no-transfer-queue] [--mesh FILE]... [--instances N]
+//                    [--draw direct|indirect] [--no-culling] [--parallel-recording]
+//                    [--command-reset buffer|pool]
+
+struct BenchOptions {
+  uint32_t frames = 1000;
+  uint32_t warmup = 100;
+  uint32_t width = 800;
+  uint32_t height = 600;
+  uint32_t framesInFlight = 2;
+  bool validation = false;
+  bool transferQueue = true;
+  std::vector<std::string> meshFiles;
+  uint32_t instances = 1;
+  DrawMode drawMode = DrawMode::eIndirect;
+  bool culling = true;
+  bool parallelRecording = false;
+  CommandResetMode commandReset = CommandResetMode::ePerFramePool;
+};
+
+struct FrameStats {
+  double mean = 0.0;
+  double p50 = 0.0;
+  double p95 = 0.0;
+  double p99 = 0.0;
+  double max = 0.0;
+};
+
+static uint32_t parseCount(const std::string& name, const char* value) {
+  char* end = nullptr;
+  unsigned long v = std::strtoul(value, &end, 10);
+  if (end == value || *end != '\0') {
+    throw std::runtime_error("invalid value for " + name + ": " + value);
+  }
+  return static_cast<uint32_t>(v);
+}
+
+static BenchOptions parseOptions(int argc, char** argv) {
+  BenchOptions options;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--validation") {
+      options.validation = true;
+      continue;
+    }
+    if (arg == "--no-transfer-queue") {
+      options.transferQueue = false;
+      continue;
+    }
+    if (arg == "--no-culling") {
+      options.culling = false;
+      continue;
+    }
+    if (arg == "--parallel-recording") {
+      options.parallelRecording = true;
+      continue;
+    }
+    if (i + 1 >= argc) {
+      throw std::runtime_error("missing value for " + arg);
+    }
+    if (arg == "--frames") {
+      options.frames = parseCount(arg, argv[++i]);
+    } else if (arg == "--warmup") {
+      options.warmup = parseCount(arg, argv[++i]);
+    } else if (arg == "--width") {
+      options.width = parseCount(arg, argv[++i]);
+    } else if (arg == "--height") {
+      options.height = parseCount(arg, argv[++i]);
+    } else if (arg == "--frames-in-flight") {
+      options.framesInFlight = parseCount(arg, argv[++i]);
+    } else if (arg == "--instances") {
+      options.instances = parseCount(arg, argv[++i]);
+    } else if (arg == "--draw") {
+      std::string mode = argv[++i];
+      if (mode == "direct") {
+        options.drawMode = DrawMode::eDirect;
+      } else if (mode == "indirect") {
+        options.drawMode = DrawMode::eIndirect;
+      } else {
+        throw std::runtime_error("invalid value for --draw: " + mode);
+      }
+    } else if (arg == "--command-reset") {
+      std::string mode = argv[++i];
+      if (mode == "buffer") {
+        options.commandReset = CommandResetMode::ePerBuffer;
+      } else if (mode == "pool") {
+        options.commandReset = CommandResetMode::ePerFramePool;
+      } else {
+        throw std::runtime_error("invalid value for --command-reset: " + mode);
+      }
+    } else if (arg == "--mesh") {
+      options.meshFiles.push_back(argv[++i]);
+    } else {
+      throw std::runtime_error("unknown option: " + arg);
+    }
+  }
+  if (options.frames == 0) {
+    throw std::runtime_error("--frames must be greater than 0");
+  }
+  if (options.instances == 0) {
+    throw std::runtime_error("--instances must be greater than 0");
+  }
+  return options;
+}
+
+// nearest-rank percentile, samples must be sorted
+static double percentile(const std::vector<double>& samples, double p) {
+  size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * samples.size()));
+  rank = std::clamp<size_t>(rank, 1, samples.size());
+  return samples[rank - 1];
+}
+
+static FrameStats computeStats(std::vector<double> samples) {
+  FrameStats stats;
+  std::sort(samples.begin(), samples.end());
+  stats.mean = std::accumulate(samples.begin(), samples.end(), 0.0) / samples.size();
+  stats.p50 = percentile(samples, 50.0);
+  stats.p95 = percentile(samples, 95.0);
+  stats.p99 = percentile(samples, 99.0);
+  stats.max = samples.back();
+  return stats;
+}
+
+static void printStats(const FrameStats& stats, const std::string& indent) {
+  std::cout << indent << "  \"mean\": " << stats.mean << ",\n"
+            << indent << "  \"p50\": " << stats.p50 << ",\n"
+            << indent << "  \"p95\": " << stats.p95 << ",\n"
+            << indent << "  \"p99\": " << stats.p99 << ",\n"
+            << indent << "  \"max\": " << stats.max << "\n";
+}
+
+static void printReport(
+    const BenchOptions& options, 
+    const FrameStats& cpu, 
+    const std::map<std::string, FrameStats>& gpuPasses, 
+    const MemoryStats& memory, 
+    double startupMs, 
+    double fps) {
+  std::cout << "{\n"
+            << "  \"frames\": " << options.frames << ",\n"
+            << "  \"warmup\": " << options.warmup << ",\n"
+            << "  \"width\": " << options.width << ",\n"
+            << "  \"height\": " << options.height << ",\n"
+            << "  \"frames_in_flight\": " << options.framesInFlight << ",\n"
+            << "  \"transfer_queue\": " << (options.transferQueue ? "true" : "false") << ",\n"
+            << "  \"meshes\": " << options.meshFiles.size() << ",\n"
+            << "  \"instances\": " << options.instances << ",\n"
+            << "  \"draw_mode\": \"" << (options.drawMode == DrawMode::eIndirect ? "indirect" : "direct") << "\",\n"
+            << "  \"culling\": " << (options.culling && options.drawMode == DrawMode::eIndirect ? "true" : "false") << ",\n"
+            << "  \"parallel_recording\": " << (options.parallelRecording && options.drawMode == DrawMode::eDirect ? "true" : "false") << ",\n"
+            << "  \"command_reset\": \"" << (options.commandReset == CommandResetMode::ePerFramePool ? "pool" : "buffer") << "\",\n"
+            << "  \"startup_ms\": " << startupMs << ",\n"
+            << "  \"cpu_frame_ms\": {\n";
+  printStats(cpu, "  ");
+  std::cout << "  },\n"
+            << "  \"gpu_pass_ms\": {";
+  for (auto it = gpuPasses.begin(); it != gpuPasses.end(); it++) {
+    std::cout << (it == gpuPasses.begin() ? "\n" : ",\n")
+              << "    \"" << it->first << "\": {\n";
+    printStats(it->second, "    ");
+    std::cout << "    }";
+  }
+  std::cout << (gpuPasses.empty() ? "},\n" : "\n  },\n")
+            << "  \"memory\": {\n"
+            << "    \"blocks\": " << memory.blockCount << ",\n"
+            << "    \"allocations\": " << memory.allocationCount << ",\n"
+            << "    \"bytes_reserved\": " << memory.bytesReserved << ",\n"
+            << "    \"bytes_in_use\": " << memory.bytesInUse << ",\n"
+            << "    \"fragmentation\": " << memory.fragmentation << "\n"
+            << "  },\n"
+            << "  \"fps\": " << fps << "\n"
+            << "}" << std::endl;
+}
+
+// a square grid of scaled down copies filling the unit square the quad covers, tinted by position
+static std::vector<InstanceData> makeInstanceGrid(uint32_t count) {
+  uint32_t side = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(count))));
+  float cell = 1.0f / side;
+
+  std::vector<InstanceData> instances;
+  instances.reserve(count);
+  for (uint32_t i = 0; i < count; i++) {
+    float x = (i % side + 0.5f) * cell - 0.5f;
+    float y = (i / side + 0.5f) * cell - 0.5f;
+    glm::mat4 transform = glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(x, y, 0.0f)), glm::vec3(cell));
+    glm::vec4 tint(x + 0.5f, y + 0.5f, 1.0f, 1.0f);
+    instances.push_back(InstanceData::pack(transform, tint, 0));
+  }
+  return instances;
+}
+
+static void runBench(const BenchOptions& options) {
+  VulkanInstance vkInstance;
+  RenderAssets assets;
+  Renderer renderer;
+
+  auto startupStart = std::chrono::steady_clock::now();
+
+  vkInstance.setHeadless(options.width, options.height);
+  vkInstance.setEnableValidationLayers(options.validation);
+  vkInstance.setEnableTransferQueue(options.transferQueue);
+  vkInstance.setFramesInFlight(options.framesInFlight);
+  vkInstance.setCommandResetMode(options.commandReset);
+  vkInstance.init();
+  assets.init(&vkInstance);
+  renderer.setMeshFiles(options.meshFiles);
+  renderer.setDrawMode(options.drawMode);
+  renderer.setFrustumCulling(options.culling);
+  renderer.setParallelRecording(options.parallelRecording);
+  if (options.instances > 1) {
+    renderer.setInstances(makeInstanceGrid(options.instances));
+  }
+  renderer.init(&vkInstance, &assets);
+
+  // meshes stream in from drawFrame, startup lasts until every one of them is resident
+  while (!renderer.isLoaded()) {
+    renderer.drawFrame();
+  }
+
+  double startupMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startupStart).count();
+
+  for (uint32_t i = 0; i < options.warmup; i++) {
+    renderer.drawFrame();
+  }
+
+  std::vector<double> frameTimes;
+  frameTimes.reserve(options.frames);
+  std::map<std::string, std::vector<double>> gpuTimes;
+
+  auto benchStart = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < options.frames; i++) {
+    auto frameStart = std::chrono::steady_clock::now();
+    renderer.drawFrame();
+    auto frameEnd = std::chrono::steady_clock::now();
+    frameTimes.push_back(std::chrono::duration<double, std::milli>(frameEnd - frameStart).count());
+
+    // frames whose queries were not ready report nothing and are left out of the pass stats
+    for (const auto& passTime : vkInstance.getGpuPassTimes()) {
+      gpuTimes[passTime.name].push_back(passTime.milliseconds);
+    }
+  }
+  auto benchEnd = std::chrono::steady_clock::now();
+
+  double seconds = std::chrono::duration<double>(benchEnd - benchStart).count();
+  MemoryStats memory = assets.getMemoryStats();
+
+  renderer.cleanup();
+  assets.cleanup();
+  vkInstance.cleanup();
+
+  std::map<std::string, FrameStats> gpuPasses;
+  for (const auto& [name, samples] : gpuTimes) {
+    gpuPasses[name] = computeStats(samples);
+  }
+
+  printReport(options, computeStats(frameTimes), gpuPasses, memory, startupMs, options.frames / seconds);
+}
+
+int main(int argc, char** argv) {
+  try {
+    runBench(parseOptions(argc, argv));
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
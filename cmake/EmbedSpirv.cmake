@@ -0,0 +1,34 @@
+# turns compiled spir-v files into constexpr uint32_t arrays plus the table ShaderRegistry.cc looks them up in
+#
+# cmake -D SPIRV_FILES="a.vert.spv|b.frag.spv" -D OUTPUT=EmbeddedShaders.inc -P EmbedSpirv.cmake
+#
+# the list is separated by | because ; would be split up by add_custom_command
+
+string(REPLACE "|" ";" SPIRV_FILES "${SPIRV_FILES}")
+
+set(CONTENT "// generated by cmake/EmbedSpirv.cmake from glslShaders/, do not edit\n\n")
+set(ENTRIES "")
+
+foreach(SPIRV ${SPIRV_FILES})
+  get_filename_component(FILE_NAME ${SPIRV} NAME)
+  string(REGEX REPLACE "\\.spv$" "" SHADER_NAME ${FILE_NAME})
+  string(MAKE_C_IDENTIFIER ${SHADER_NAME} SYMBOL)
+
+  file(READ ${SPIRV} HEX HEX)
+  string(LENGTH "${HEX}" HEX_LENGTH)
+  math(EXPR REMAINDER "${HEX_LENGTH} % 8")
+  if (HEX_LENGTH EQUAL 0 OR NOT REMAINDER EQUAL 0)
+    message(FATAL_ERROR "${SPIRV} is not a whole number of spir-v words")
+  endif()
+
+  # spir-v words are little endian, 8 words per line
+  string(REGEX REPLACE "(..)(..)(..)(..)" "0x\\4\\3\\2\\1, " WORDS "${HEX}")
+  string(REGEX REPLACE "(0x........, 0x........, 0x........, 0x........, 0x........, 0x........, 0x........, 0x........, )" "\\1\n  " WORDS "${WORDS}")
+
+  string(APPEND CONTENT "static constexpr uint32_t ${SYMBOL}[] = {\n  ${WORDS}\n};\n\n")
+  string(APPEND ENTRIES "  { \"${SHADER_NAME}\", ${SYMBOL}, sizeof(${SYMBOL}) / sizeof(uint32_t) },\n")
+endforeach()
+
+string(APPEND CONTENT "static const EmbeddedShader embeddedShaders[] = {\n${ENTRIES}};\n")
+
+file(WRITE ${OUTPUT} "${CONTENT}")
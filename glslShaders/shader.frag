@@ -1,12 +1,16 @@
 #version 450
+#extension GL_EXT_nonuniform_qualifier : require
 
-layout(binding = 1) uniform sampler2D texSampler;
+// every texture in one partially bound array, see RenderAssets::createTextureSetLayout
+layout(set = 1, binding = 0) uniform sampler2D textures[];
 
 layout(location = 0) in vec3 fragColor;
 layout(location = 1) in vec2 fragTexCoord;
+layout(location = 2) in vec4 fragTint;
+layout(location = 3) flat in uint fragTextureIndex;
 
 layout(location = 0) out vec4 outColor;
 
 void main() {
-    outColor = texture(texSampler, fragTexCoord);
+    outColor = texture(textures[nonuniformEXT(fragTextureIndex)], fragTexCoord) * fragTint;
 }
@@ -1,20 +1,34 @@
 #version 450
 
-layout(binding = 0) uniform UniformBufferObject {
-    mat4 model;
+layout(set = 0, binding = 0) uniform UniformBufferObject {
     mat4 view;
     mat4 proj;
 } ubo;
 
-layout(location = 0) in vec2 inPosition;
+layout(push_constant) uniform DrawConstants {
+    mat4 model;
+    uint materialIndex;
+} draw;
+
+layout(location = 0) in vec4 inPosition;
 layout(location = 1) in vec3 inColor;
 layout(location = 2) in vec2 inTexCoord;
 
+// per instance, the transform takes locations 3 to 6
+layout(location = 3) in mat4 inTransform;
+layout(location = 7) in vec4 inTint;
+layout(location = 8) in uint inTextureIndex;
+
 layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec2 fragTexCoord;
+layout(location = 2) out vec4 fragTint;
+layout(location = 3) flat out uint fragTextureIndex;
 
 void main() {
-    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inPosition, 0.0, 1.0);
+    gl_Position = ubo.proj * ubo.view * draw.model * inTransform * inPosition;
     fragColor = inColor;
     fragTexCoord = inTexCoord;
+    fragTint = inTint;
+    // the instance picks a texture relative to the mesh's material
+    fragTextureIndex = draw.materialIndex + inTextureIndex;
 }
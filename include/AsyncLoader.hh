@@ -0,0 +1,113 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+
+#include "ThreadPool.hh"
+
+// runs load jobs on a thread pool and hands the results back in the order they finish,
+// so the caller can upload each one while the others are still loading
+template<typename T>
+class AsyncLoader {
+public:
+  AsyncLoader() = default;
+
+  // waits for jobs still running on the pool, they write into this loader
+  ~AsyncLoader() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _finishedAvailable.wait(lock, [this]() { return _loading == 0; });
+  }
+
+  void init(ThreadPool* threadPool) {
+    _threadPool = threadPool;
+  }
+public:
+  // returns an id that next() reports the result with
+  uint32_t request(std::function<T()> load) {
+    uint32_t id = _nextId++;
+    _outstanding++;
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _loading++;
+    }
+
+    // the future is not needed, results come back through _finished
+    _threadPool->submit([this, id, load]() {
+      Finished finished;
+      finished.id = id;
+      try {
+        finished.result = load();
+      } catch (...) {
+        finished.error = std::current_exception();
+      }
+
+      // notified under the lock, the destructor may run as soon as _loading hits 0
+      std::lock_guard<std::mutex> lock(_mutex);
+      _finished.push_back(std::move(finished));
+      _loading--;
+      _finishedAvailable.notify_all();
+    });
+
+    return id;
+  }
+
+  // blocks until a requested job is done, false once every request has been returned
+  // a job that threw rethrows its exception here
+  bool next(uint32_t* id, T* result) {
+    return take(id, result, true);
+  }
+
+  // like next() but never blocks, false as well when no job has finished yet
+  bool poll(uint32_t* id, T* result) {
+    return take(id, result, false);
+  }
+
+  // every request has been returned
+  bool done() const {
+    return _outstanding == 0;
+  }
+private:
+  struct Finished {
+    uint32_t id;
+    T result;
+    std::exception_ptr error;
+  };
+private:
+  bool take(uint32_t* id, T* result, bool wait) {
+    if (_outstanding == 0) return false;
+
+    Finished finished;
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      if (wait) {
+        _finishedAvailable.wait(lock, [this]() { return !_finished.empty(); });
+      } else if (_finished.empty()) {
+        return false;
+      }
+      finished = std::move(_finished.front());
+      _finished.pop_front();
+    }
+    _outstanding--;
+
+    if (finished.error) {
+      std::rethrow_exception(finished.error);
+    }
+
+    *id = finished.id;
+    *result = std::move(finished.result);
+    return true;
+  }
+private:
+  ThreadPool* _threadPool = nullptr;
+  uint32_t _nextId = 0;
+  // requested but not returned by next() or poll() yet
+  uint32_t _outstanding = 0;
+
+  std::mutex _mutex;
+  std::condition_variable _finishedAvailable;
+  std::deque<Finished> _finished;
+  uint32_t _loading = 0;
+};
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <map>
+#include <vector>
+
+// one resource written to a set, buffer or image fields are used depending on type
+struct DescriptorBinding {
+  uint32_t binding = 0;
+  vk::DescriptorType type = vk::DescriptorType::eUniformBuffer;
+  vk::Buffer buffer = nullptr;
+  vk::DeviceSize offset = 0;
+  vk::DeviceSize range = VK_WHOLE_SIZE;
+  vk::ImageView imageView = nullptr;
+  vk::Sampler sampler = nullptr;
+  vk::ImageLayout imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+};
+
+// sets are carved out of pools chained per layout, when a pool runs out the next one
+// is created twice as large, so nothing has to know the number of sets up front
+// every set is persistent, frames in flight share them and pick their slice with dynamic offsets
+class DescriptorAllocator {
+public:
+  DescriptorAllocator() = default;
+  ~DescriptorAllocator() = default;
+  void init(vk::Device device);
+  void cleanup();
+public:
+  // descriptor counts of a single set of layout, every layout has to be registered before allocating
+  void registerLayout(
+      vk::DescriptorSetLayout layout,
+      const std::vector<vk::DescriptorPoolSize>& setSizes,
+      uint32_t firstPoolSets = 16,
+      vk::DescriptorPoolCreateFlags flags = {}
+      );
+  vk::DescriptorSet allocate(vk::DescriptorSetLayout layout);
+  // a persistent set with exactly these bindings written, the same bindings give back the same set
+  vk::DescriptorSet getOrCreate(vk::DescriptorSetLayout layout, const std::vector<DescriptorBinding>& bindings);
+  // cached sets referring to it are not handed out again, has to happen before the handle can be reused
+  // and only once no pending frame uses those sets, they are rewritten by later getOrCreate() calls
+  void evict(vk::Buffer buffer);
+  void evict(vk::ImageView imageView);
+private:
+  struct LayoutInfo {
+    std::vector<vk::DescriptorPoolSize> setSizes;
+    uint32_t firstPoolSets = 16;
+    vk::DescriptorPoolCreateFlags flags;
+  };
+  struct PoolChain {
+    std::vector<vk::DescriptorPool> pools;
+    // pools before this one are full
+    uint32_t current = 0;
+  };
+private:
+  vk::Device _device = nullptr;
+  std::map<VkDescriptorSetLayout, LayoutInfo> _layouts;
+  std::map<VkDescriptorSetLayout, PoolChain> _chains;
+  std::map<std::vector<uint64_t>, vk::DescriptorSet> _setCache;
+  // evicted from the cache, ready to be rewritten
+  std::map<VkDescriptorSetLayout, std::vector<vk::DescriptorSet>> _freeSets;
+private:
+  vk::DescriptorSet allocateFromChain(vk::DescriptorSetLayout layout, PoolChain* chain);
+  vk::DescriptorPool createPool(const LayoutInfo& info, uint32_t maxSets);
+  void writeSet(vk::DescriptorSet set, const std::vector<DescriptorBinding>& bindings);
+  void evictHandle(uint64_t handle, uint32_t keyField);
+  void destroyChain(PoolChain* chain);
+};
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <vector>
+
+#include "SlotMap.hh"
+
+class RenderAssets;
+struct MeshData;
+
+// where a mesh ended up, the offsets go straight into drawIndexed / DrawIndexedIndirectCommand
+struct GeometryRange {
+  uint32_t block = 0;
+  uint32_t indexCount = 0;
+  uint32_t firstIndex = 0;
+  int32_t vertexOffset = 0;
+};
+
+// packs many meshes into a few shared vertex/index buffers so they can be drawn
+// with one binding and one indirect draw per block
+// every block holds one index type, a mesh bigger than a block gets a block of its own
+class GeometryArena {
+public:
+  GeometryArena() = default;
+  ~GeometryArena() = default;
+  // the buffers belong to assets and are released with it
+  void init(RenderAssets* assets, vk::DeviceSize blockSize);
+public:
+  // records the upload, it reaches the gpu with the next RenderAssets::flushUploads()
+  GeometryRange add(const MeshData& mesh);
+public:
+  uint32_t getBlockCount() const;
+  vk::Buffer getVertexBuffer(uint32_t block) const;
+  vk::Buffer getIndexBuffer(uint32_t block) const;
+  vk::IndexType getIndexType(uint32_t block) const;
+private:
+  struct Block {
+    BufferHandle vertexBuffer;
+    BufferHandle indexBuffer;
+    vk::IndexType indexType;
+    vk::DeviceSize vertexCapacity;
+    vk::DeviceSize vertexUsed;
+    vk::DeviceSize indexCapacity;
+    vk::DeviceSize indexUsed;
+  };
+private:
+  RenderAssets* _assets = nullptr;
+  vk::DeviceSize _blockSize = 0;
+  std::vector<Block> _blocks;
+private:
+  uint32_t findBlock(vk::IndexType indexType, vk::DeviceSize vertexSize, vk::DeviceSize indexSize);
+};
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace myUtils {
+
+  uint32_t mipLevelCount(uint32_t width, uint32_t height);
+
+  // 2x2 box filter of an 8 bit per channel image into (width / 2) x (height / 2), at least 1x1,
+  // odd sizes drop their last row/column, a side of 1 is averaged with itself
+  void downsample(const uint8_t* src, uint32_t width, uint32_t height, uint32_t channels, uint8_t* dst);
+
+  // every level of the chain below level 0, tightly packed, for formats that cannot be blitted
+  std::vector<std::vector<uint8_t>> generateMipChain(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t channels);
+
+};
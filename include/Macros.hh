@@ -1,4 +1,10 @@
-#define MAX_FRAMES_IN_FLIGHT (uint32_t)2
+#define MAX_FRAMES_IN_FLIGHT (uint32_t)4
+#define MAX_GPU_TIMESTAMP_PASSES (uint32_t)8
+#define MEMORY_BLOCK_SIZE (uint64_t)(64 * 1024 * 1024)
+#define STAGING_RING_SIZE (uint64_t)(32 * 1024 * 1024)
+#define GEOMETRY_BLOCK_SIZE (uint64_t)(16 * 1024 * 1024)
+#define UNIFORM_RING_FRAME_SIZE (uint64_t)(1024 * 1024)
+#define MAX_BINDLESS_TEXTURES (uint32_t)1024
 
 #define IF_THROW(expr, message) \
   if ((expr)) { \
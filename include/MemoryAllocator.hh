@@ -0,0 +1,73 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <map>
+#include <vector>
+
+struct MemoryAllocation {
+  vk::DeviceMemory memory = nullptr;
+  vk::DeviceSize offset = 0;
+  vk::DeviceSize size = 0;
+  uint32_t memoryType = 0;
+  uint32_t block = 0;
+};
+
+struct MemoryStats {
+  uint32_t blockCount = 0;
+  uint32_t allocationCount = 0;
+  vk::DeviceSize bytesReserved = 0;
+  vk::DeviceSize bytesInUse = 0;
+  vk::DeviceSize largestFreeRange = 0;
+  // 0 when all free space is one range, approaching 1 when it is scattered
+  float fragmentation = 0.0f;
+};
+
+// hands out ranges of large vk::DeviceMemory blocks instead of one allocation per resource
+// blocks are kept per memory type, ranges are found first-fit in a free list sorted by offset
+// linear (buffers) and optimal (images) resources never share a bufferImageGranularity page
+class MemoryAllocator {
+public:
+  MemoryAllocator() = default;
+  ~MemoryAllocator() = default;
+  void init(vk::Device device, vk::PhysicalDevice gpu);
+  void cleanup();
+public:
+  MemoryAllocation allocate(
+      const vk::MemoryRequirements& requirements,
+      vk::MemoryPropertyFlags memoryProp,
+      bool linear
+      );
+
+  void free(const MemoryAllocation& allocation);
+
+  // blocks are mapped once and stay mapped, memory must be host visible
+  void* map(const MemoryAllocation& allocation);
+
+  MemoryStats getStats() const;
+private:
+  struct Range {
+    vk::DeviceSize size;
+    bool free;
+    bool linear;
+  };
+
+  struct Block {
+    vk::DeviceMemory memory = nullptr;
+    vk::DeviceSize size = 0;
+    uint32_t allocationCount = 0;
+    void* mapped = nullptr;
+    std::map<vk::DeviceSize, Range> ranges;
+  };
+private:
+  vk::Device _device = nullptr;
+  vk::PhysicalDevice _gpu = nullptr;
+  vk::DeviceSize _granularity = 1;
+  vk::PhysicalDeviceMemoryProperties _memoryProperties;
+  std::vector<std::vector<Block>> _blocks;
+private:
+  bool allocateFromBlock(Block& block, vk::DeviceSize size, vk::DeviceSize alignment, bool linear, vk::DeviceSize* offset);
+  uint32_t createBlock(uint32_t memoryType, vk::DeviceSize size);
+  void releaseBlock(Block& block);
+  vk::DeviceSize preferredBlockSize(uint32_t memoryType) const;
+};
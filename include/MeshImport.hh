@@ -0,0 +1,32 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <string>
+#include <vector>
+
+#include "Structs.hh"
+
+struct MeshData {
+  std::vector<Vertex> vertices;
+  // 16 bit when every index fits, 32 bit otherwise, tightly packed
+  vk::IndexType indexType = vk::IndexType::eUint32;
+  uint32_t indexCount = 0;
+  std::vector<uint8_t> indices;
+  // bounding sphere, xyz center and w radius
+  glm::vec4 bounds = glm::vec4(0.0f);
+};
+
+namespace myUtils {
+
+  // .obj or .glb by extension, one MeshData per obj file and one per gltf triangle primitive
+  // gltf node transforms are not applied, every primitive is in its mesh's local space
+  std::vector<MeshData> importMesh(const std::string& filename);
+
+  // stores indices in the narrowest type that holds vertexCount - 1
+  void packIndices(const std::vector<uint32_t>& indices, uint32_t vertexCount, MeshData* mesh);
+
+  // sphere around the center of the bounding box, from the packed positions
+  void computeBounds(MeshData* mesh);
+
+};
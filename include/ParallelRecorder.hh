@@ -0,0 +1,49 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <functional>
+#include <vector>
+
+class ThreadPool;
+
+// records a range of work split into chunks on the thread pool, one secondary command buffer per chunk
+// every chunk slot has its own command pool per frame in flight, so no two threads ever share a pool,
+// the pools are reset as a whole in beginFrame() and their buffers handed out again in order
+class ParallelRecorder {
+public:
+  ParallelRecorder() = default;
+  ~ParallelRecorder() = default;
+  // one chunk slot per pool thread, record() waits on its jobs so the pool should not run long ones
+  void init(vk::Device device, uint32_t queueFamily, ThreadPool* threadPool, uint32_t framesInFlight);
+  // the device must be idle
+  void cleanup();
+public:
+  // the frame's previous buffers must no longer be in use, i.e. its fence has been waited on
+  void beginFrame(uint32_t frame);
+  // calls recordChunk(buffer, begin, end) on the workers for consecutive pieces of [0, count),
+  // each buffer is already begun to continue the inherited render pass and is ended afterwards,
+  // the returned buffers are in range order, ready for executeCommands
+  std::vector<vk::CommandBuffer> record(
+      uint32_t count,
+      const vk::CommandBufferInheritanceInfo& inheritance,
+      const std::function<void(vk::CommandBuffer, uint32_t, uint32_t)>& recordChunk
+      );
+public:
+  uint32_t getChunkCount() const;
+private:
+  struct ChunkPool {
+    vk::CommandPool pool = nullptr;
+    std::vector<vk::CommandBuffer> buffers;
+    // buffers before this one were handed out this frame
+    uint32_t next = 0;
+  };
+private:
+  vk::Device _device = nullptr;
+  ThreadPool* _threadPool = nullptr;
+  uint32_t _currentFrame = 0;
+  // [frame][chunk slot]
+  std::vector<std::vector<ChunkPool>> _pools;
+private:
+  vk::CommandBuffer nextBuffer(ChunkPool* chunkPool);
+};
@@ -1,62 +1,134 @@
 #include <vulkan/vulkan.hpp>
 
-#include <unordered_map>
+#include <string>
+#include <vector>
+
+#include "DescriptorAllocator.hh"
+#include "MemoryAllocator.hh"
+#include "SlotMap.hh"
+#include "StagingRing.hh"
+#include "UploadBatch.hh"
 
 class VulkanInstance;
 
+struct BufferResource {
+  vk::Buffer buffer = nullptr;
+  MemoryAllocation memory;
+};
+
+struct ImageResource {
+  vk::Image image = nullptr;
+  MemoryAllocation memory;
+  vk::ImageView view = nullptr;
+  vk::Format format = vk::Format::eUndefined;
+  vk::Extent2D extent;
+  uint32_t mipLevels = 1;
+};
+
 class RenderAssets {
 public:
   RenderAssets() = default;
   ~RenderAssets() = default;
   void init(VulkanInstance* instance);
   void cleanup();
+  void setPipelineCachePath(const std::string& path);
 public:
+  vk::PipelineCache getPipelineCache() const;
   vk::Pipeline getGraphicsPipeline() const;
   vk::PipelineLayout getGraphicsPipelineLayout() const;
-  vk::DescriptorPool getDescriptorPool() const;
   vk::DescriptorSetLayout getDescriptorSetLayout() const;
   const vk::DescriptorSet* getDescriptorSet() const;
-  vk::Buffer getBuffer(uint32_t index) const;
-  vk::Image getImage(uint32_t index) const;
-  vk::ImageView getImageView(uint32_t index) const;
+  // set 1 of the graphics pipeline, shared by every frame
+  vk::DescriptorSet getTextureDescriptorSet() const;
+  vk::Pipeline getCullPipeline() const;
+  vk::PipelineLayout getCullPipelineLayout() const;
+  const vk::DescriptorSet* getCullDescriptorSet() const;
+  vk::Buffer getBuffer(BufferHandle handle) const;
+  vk::Image getImage(ImageHandle handle) const;
+  vk::ImageView getImageView(ImageHandle handle) const;
   vk::Sampler getTextureSampler() const;
+  MemoryStats getMemoryStats() const;
+  bool supportsMipmapBlit(vk::Format format) const;
+  bool supportsBlockCompression() const;
+  bool supportsSrgbGrey() const;
 public:
-  uint32_t createImage(
+  ImageHandle createImage(
       uint32_t width, 
       uint32_t height, 
+      uint32_t mipLevels, 
       vk::Format format, 
       vk::ImageTiling tiling, 
       vk::ImageUsageFlags usage, 
       vk::MemoryPropertyFlags memoryProp
       );
 
-  void createImageView(uint32_t index);
+  void createImageView(ImageHandle handle, vk::ComponentMapping components = {});
 
-  uint32_t createBuffer(
+  BufferHandle createBuffer(
       vk::DeviceSize size, 
       vk::BufferUsageFlags usage, 
       vk::MemoryPropertyFlags memoryProp
       );
 
-  void mapMemory(uint32_t index, vk::DeviceSize size, void** mem);
+  // the slot is reused right away, the vulkan objects are destroyed once
+  // no frame in flight can still be using them, see collectGarbage()
+  void destroyBuffer(BufferHandle handle);
+  void destroyImage(ImageHandle handle);
+  void collectGarbage();
+
+  void mapMemory(BufferHandle handle, vk::DeviceSize size, void** mem);
+
+  StagingAllocation allocateStaging(vk::DeviceSize size);
 
-  void updateDescriptorSets(uint32_t bufferIndex, uint32_t imageIndex);
+  // sets come from the allocator's cache, calling these again with the same buffers allocates nothing
+  void updateDescriptorSets(BufferHandle buffer);
+  // element index of the bindless texture array, safe while the set is bound by frames in flight
+  // as long as they do not sample that element
+  void writeTextureDescriptor(uint32_t index, ImageHandle image);
+  // the uniform buffer is bound dynamic with a UniformBufferObject slice
+  void updateCullDescriptorSets(
+      BufferHandle uniformBuffer, 
+      BufferHandle instances, 
+      BufferHandle bounds, 
+      BufferHandle commands, 
+      BufferHandle visibleInstances
+      );
 
   void storeBuffer(
-      vk::Buffer src, 
-      uint32_t dst, 
-      vk::DeviceSize size
+      const StagingAllocation& src, 
+      BufferHandle dst, 
+      vk::DeviceSize size,
+      vk::DeviceSize dstOffset = 0
       );
 
+  // for data that may not fit the staging ring at once
+  void uploadBuffer(BufferHandle dst, const void* data, vk::DeviceSize size, vk::DeviceSize dstOffset = 0);
+
   void storeBufferToImage(
-      vk::Buffer src,
-      uint32_t dst, 
+      const StagingAllocation& src,
+      ImageHandle dst, 
       const uint32_t& width, 
-      const uint32_t& height
+      const uint32_t& height, 
+      uint32_t mipLevel = 0
+      );
+
+  void transitionImageLayout(
+      ImageHandle handle, 
+      vk::ImageLayout oldLayout, 
+      vk::ImageLayout newLayout, 
+      uint32_t baseMipLevel = 0, 
+      uint32_t levelCount = VK_REMAINING_MIP_LEVELS
       );
+
+  void generateMipmaps(ImageHandle handle);
+
+  uint64_t flushUploads();
+  void acquireUploads(vk::CommandBuffer commandBuffer);
+  bool isUploadComplete(uint64_t ticket);
+  bool isUploadReady(uint64_t ticket) const;
+  void waitUploads(uint64_t ticket);
 private:
-  uint32_t _bufferIndex = 0;
-  uint32_t _imageIndex = 0;
+  uint32_t _framesInFlight = 0;
 private:
   VulkanInstance* _instance = nullptr;
   vk::Device _device = nullptr;
@@ -64,30 +136,49 @@ private:
   vk::Queue _graphicsQueue = nullptr;
   vk::CommandPool _commandPool = nullptr;
 private:
+  std::string _pipelineCachePath = "pipeline_cache.bin";
+  vk::PipelineCache _pipelineCache = nullptr;
   vk::DescriptorSetLayout _descriptorSetLayout = nullptr;
+  vk::DescriptorSetLayout _textureSetLayout = nullptr;
   vk::PipelineLayout _graphicsPipelineLayout = nullptr;
   vk::Pipeline _graphicsPipeline = nullptr;
-  std::unordered_map<uint32_t, vk::Buffer> _buffers;
-  std::unordered_map<uint32_t, vk::DeviceMemory> _memories;
-  std::unordered_map<uint32_t, vk::Image> _images;
-  std::unordered_map<uint32_t, vk::DeviceMemory> _imageMemories;
-  std::unordered_map<uint32_t, vk::ImageView> _imageViews;
+  vk::DescriptorSetLayout _cullDescriptorSetLayout = nullptr;
+  vk::PipelineLayout _cullPipelineLayout = nullptr;
+  vk::Pipeline _cullPipeline = nullptr;
+  SlotMap<BufferResource, BufferHandle> _buffers;
+  SlotMap<ImageResource, ImageHandle> _images;
+  // destroyed resources wait here, tagged with the frame they were destroyed in
+  std::vector<std::pair<uint64_t, BufferResource>> _retiredBuffers;
+  std::vector<std::pair<uint64_t, ImageResource>> _retiredImages;
   vk::Sampler _textureSampler;
 
-  vk::DescriptorPool _descriptorPool = nullptr;
+  MemoryAllocator _allocator;
+  StagingRing _stagingRing;
+  UploadBatch _uploadBatch;
+
+  DescriptorAllocator _descriptorAllocator;
   std::vector<vk::DescriptorSet> _descriptorSets;
+  std::vector<vk::DescriptorSet> _cullDescriptorSets;
+  vk::DescriptorSet _textureDescriptorSet = nullptr;
 private:
+  std::vector<char> loadPipelineCacheData();
+  void createPipelineCache();
   void createDescriptorSetLayout();
+  void createTextureSetLayout();
   void createGraphicsPipeline();
-  void createDescriptorPool();
+  void createCullPipeline();
+  void createDescriptorAllocator();
+  void createTextureDescriptorSet();
   void createTextureSampler();
 private:
-  void cleanupDescriptorPool();
+  void cleanupPipelineCache();
   void cleanupDescriptorSetLayout();
   void cleanupGraphicsPipelineLayout();
   void cleanupGraphicsPipeline();
+  void cleanupCullPipeline();
   void cleanupBufferMemory();
   void cleanupImageMemory();
-  void cleanupImageViews();
+  void releaseBuffer(const BufferResource& resource);
+  void releaseImage(const ImageResource& resource);
   void cleanupSamplers();
 };
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// spir-v compiled from glslShaders/ at build time and linked into the library,
+// shaders are named after their source file, e.g. "shader.vert"
+struct EmbeddedShader {
+  const char* name;
+  const uint32_t* code;
+  size_t wordCount;
+};
+
+namespace myUtils {
+
+  // throws when no shader of that name was embedded
+  const EmbeddedShader& getEmbeddedShader(const std::string& name);
+
+};
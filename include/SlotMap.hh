@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+// index into a SlotMap plus the generation of the slot when the handle was made,
+// a handle outlives its resource safely, using it afterwards is detected instead of
+// silently hitting whatever reused the slot
+template<typename Tag>
+struct Handle {
+  uint32_t index = UINT32_MAX;
+  uint32_t generation = 0;
+
+  bool valid() const { return index != UINT32_MAX; }
+  bool operator==(const Handle& other) const { return index == other.index && generation == other.generation; }
+  bool operator!=(const Handle& other) const { return !(*this == other); }
+};
+
+using BufferHandle = Handle<struct BufferTag>;
+using ImageHandle = Handle<struct ImageTag>;
+
+// values live in one contiguous vector, lookups are an index and a generation compare
+// erased slots are reused, their generation is bumped so old handles go stale
+template<typename T, typename H>
+class SlotMap {
+public:
+  H insert(const T& value) {
+    uint32_t index;
+    if (_freeSlots.empty()) {
+      index = static_cast<uint32_t>(_slots.size());
+      _slots.push_back({ value, 1, true });
+    } else {
+      index = _freeSlots.back();
+      _freeSlots.pop_back();
+      _slots[index].value = value;
+      _slots[index].occupied = true;
+    }
+    _count++;
+
+    H handle;
+    handle.index = index;
+    handle.generation = _slots[index].generation;
+    return handle;
+  }
+
+  void erase(H handle) {
+    Slot& slot = slotAt(handle);
+    slot.value = T();
+    slot.occupied = false;
+    slot.generation++;
+    _freeSlots.push_back(handle.index);
+    _count--;
+  }
+
+  bool contains(H handle) const {
+    return handle.index < _slots.size()
+        && _slots[handle.index].occupied
+        && _slots[handle.index].generation == handle.generation;
+  }
+
+  T& at(H handle) { return slotAt(handle).value; }
+  const T& at(H handle) const { return const_cast<SlotMap*>(this)->slotAt(handle).value; }
+
+  template<typename F>
+  void forEach(F f) {
+    for (auto& slot : _slots) {
+      if (slot.occupied) f(slot.value);
+    }
+  }
+
+  size_t size() const { return _count; }
+
+  void clear() {
+    for (uint32_t i = 0; i < _slots.size(); i++) {
+      if (_slots[i].occupied) {
+        _slots[i].value = T();
+        _slots[i].occupied = false;
+        _slots[i].generation++;
+        _freeSlots.push_back(i);
+      }
+    }
+    _count = 0;
+  }
+private:
+  struct Slot {
+    T value;
+    uint32_t generation;
+    bool occupied;
+  };
+private:
+  std::vector<Slot> _slots;
+  std::vector<uint32_t> _freeSlots;
+  size_t _count = 0;
+private:
+  Slot& slotAt(H handle) {
+    if (!contains(handle)) {
+      throw std::runtime_error("stale or invalid resource handle...");
+    }
+    return _slots[handle.index];
+  }
+};
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <deque>
+#include <tuple>
+#include <vector>
+
+struct StagingAllocation {
+  vk::Buffer buffer = nullptr;
+  vk::DeviceSize offset = 0;
+  void* data = nullptr;
+};
+
+// one persistently mapped host visible buffer that uploads are carved out of in order
+// everything allocated between two closeRegion() calls forms a region, the fence returned
+// by closeRegion() has to be passed to the submit that reads it, the region's bytes are
+// handed out again once that fence has signaled
+class StagingRing {
+public:
+  StagingRing() = default;
+  ~StagingRing() = default;
+  void init(vk::Device device, vk::PhysicalDevice gpu, vk::DeviceSize capacity);
+  void cleanup();
+public:
+  StagingAllocation allocate(vk::DeviceSize size, vk::DeviceSize alignment = 16);
+  std::tuple<vk::Fence, uint64_t> closeRegion();
+  bool isRegionComplete(uint64_t serial);
+  void waitRegion(uint64_t serial);
+private:
+  struct Region {
+    vk::DeviceSize begin;
+    vk::DeviceSize end;
+    vk::Fence fence;
+    uint64_t serial;
+  };
+private:
+  vk::Device _device = nullptr;
+  vk::Buffer _buffer = nullptr;
+  vk::DeviceMemory _memory = nullptr;
+  char* _mapped = nullptr;
+  vk::DeviceSize _capacity = 0;
+private:
+  vk::DeviceSize _head = 0;
+  vk::DeviceSize _openBegin = 0;
+  bool _openUsed = false;
+  uint64_t _serial = 0;
+  std::deque<Region> _regions;
+  std::vector<vk::Fence> _freeFences;
+private:
+  void reclaimRegion();
+};
@@ -1,11 +1,19 @@
+#pragma once
+
+#include <cstddef>
 #include <optional>
+#include <string>
 
 #include <vulkan/vulkan.hpp>
 #include <glm/glm.hpp>
 
+#include "VertexLayout.hh"
+
 struct QueueFamilyIndices {
   std::optional<uint32_t> graphicsFamily;
   std::optional<uint32_t> presentFamily;
+  // transfer capable family without graphics, uploads run on it asynchronously when present
+  std::optional<uint32_t> transferFamily;
 
   bool isComplete();
 };
@@ -16,17 +24,78 @@ struct SwapChainSupportDetails {
   std::vector<vk::PresentModeKHR> presentModes;
 };
 
+// 16 bytes, built with pack()
 struct Vertex {
-  glm::vec2 pos;
-  glm::vec3 color;
-  glm::vec2 texCoord;
+  // half float xyz, w = 1
+  uint64_t pos;
+  // unorm8 rgb, a = 1
+  uint32_t color;
+  // snorm16, uvs outside [-1, 1] are clamped
+  uint32_t texCoord;
+
+  using Layout = VertexLayout<
+    VertexAttribute<uint64_t, vk::Format::eR16G16B16A16Sfloat>,
+    VertexAttribute<uint32_t, vk::Format::eR8G8B8A8Unorm>,
+    VertexAttribute<uint32_t, vk::Format::eR16G16Snorm>
+    >;
+
+  static Vertex pack(const glm::vec3& pos, const glm::vec3& color, const glm::vec2& texCoord);
+};
+
+static_assert(sizeof(Vertex) == Vertex::Layout::stride(), "Vertex does not match its layout");
+static_assert(offsetof(Vertex, pos) == Vertex::Layout::offsets()[0], "Vertex does not match its layout");
+static_assert(offsetof(Vertex, color) == Vertex::Layout::offsets()[1], "Vertex does not match its layout");
+static_assert(offsetof(Vertex, texCoord) == Vertex::Layout::offsets()[2], "Vertex does not match its layout");
+
+// per instance vertex input on binding 1, 72 bytes, built with pack()
+struct InstanceData {
+  glm::mat4 transform;
+  // unorm8 rgba, multiplies the sampled color
+  uint32_t tint;
+  uint32_t textureIndex;
+
+  // the transform takes one location per column
+  using Layout = VertexLayout<
+    VertexAttribute<glm::vec4, vk::Format::eR32G32B32A32Sfloat>,
+    VertexAttribute<glm::vec4, vk::Format::eR32G32B32A32Sfloat>,
+    VertexAttribute<glm::vec4, vk::Format::eR32G32B32A32Sfloat>,
+    VertexAttribute<glm::vec4, vk::Format::eR32G32B32A32Sfloat>,
+    VertexAttribute<uint32_t, vk::Format::eR8G8B8A8Unorm>,
+    VertexAttribute<uint32_t, vk::Format::eR32Uint>
+    >;
+
+  static InstanceData pack(const glm::mat4& transform, const glm::vec4& tint, uint32_t textureIndex);
+};
+
+static_assert(sizeof(InstanceData) == InstanceData::Layout::stride(), "InstanceData does not match its layout");
+static_assert(offsetof(InstanceData, transform) == InstanceData::Layout::offsets()[0], "InstanceData does not match its layout");
+static_assert(offsetof(InstanceData, tint) == InstanceData::Layout::offsets()[4], "InstanceData does not match its layout");
+static_assert(offsetof(InstanceData, textureIndex) == InstanceData::Layout::offsets()[5], "InstanceData does not match its layout");
+// cull.comp copies instances as 18 words
+static_assert(sizeof(InstanceData) == 18 * sizeof(uint32_t), "cull.comp expects 18 word instances");
 
-  static vk::VertexInputBindingDescription getBindingDescription();
-  static std::array<vk::VertexInputAttributeDescription, 3> getAttributeDescriptions();
+struct GpuPassTime {
+  std::string name;
+  double milliseconds;
 };
 
 struct UniformBufferObject {
-  glm::mat4 model;
   glm::mat4 view;
   glm::mat4 proj;
 };
+
+// per draw data of the graphics pipeline, matches DrawConstants in shader.vert
+struct DrawPushConstants {
+  glm::mat4 model;
+  uint32_t materialIndex;
+};
+
+// matches CullParams in cull.comp
+struct CullPushConstants {
+  // the model matrix the culled draws are pushed with
+  glm::mat4 model;
+  uint32_t instanceCount;
+  uint32_t meshCount;
+  // in words, the commands of the frame being culled start there
+  uint32_t commandBase;
+};
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <string>
+#include <vector>
+
+struct TextureImportOptions {
+  // the device can sample BC1/BC3/BC4/BC5, see RenderAssets::supportsBlockCompression()
+  bool blockCompression = false;
+  // the device can sample R8Srgb/R8G8Srgb, see RenderAssets::supportsSrgbGrey()
+  bool srgbGrey = false;
+  // encoded textures are kept here, keyed by the contents of the source file
+  std::string cacheDirectory = "texture_cache";
+};
+
+// levels are tightly packed, level 0 first
+// block compressed textures come with their whole mip chain, uncompressed ones with level 0 only
+// so the chain can still be blitted on the gpu
+struct TextureData {
+  vk::Format format = vk::Format::eUndefined;
+  uint32_t width = 0;
+  uint32_t height = 0;
+  // bytes per pixel of uncompressed levels, 0 when block compressed
+  uint32_t channels = 0;
+  // grey and grey+alpha sources are stored in one/two channels and expanded by the view
+  vk::ComponentMapping components;
+  std::vector<std::vector<uint8_t>> levels;
+};
+
+namespace myUtils {
+
+  // picks the smallest format that keeps the channels the source has:
+  // grey -> BC4 / R8, grey+alpha -> BC5 / RG8, opaque color -> BC1, color with alpha -> BC3,
+  // the uncompressed fallback for color is R8G8B8A8Srgb
+  // uncompressed grey stays srgb when srgbGrey is set, BC4/BC5 have no srgb variants so grey
+  // is converted to linear for them and for the unorm fallback
+  TextureData importTexture(const std::string& filename, const TextureImportOptions& options);
+
+  // 4x4 blocks, sizes that are not a multiple of 4 repeat the last row/column
+  std::vector<uint8_t> encodeBC1(const uint8_t* rgba, uint32_t width, uint32_t height);
+  std::vector<uint8_t> encodeBC3(const uint8_t* rgba, uint32_t width, uint32_t height);
+  std::vector<uint8_t> encodeBC4(const uint8_t* r, uint32_t width, uint32_t height);
+  std::vector<uint8_t> encodeBC5(const uint8_t* rg, uint32_t width, uint32_t height);
+
+};
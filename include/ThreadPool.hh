@@ -0,0 +1,45 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// fixed set of worker threads taking jobs from one fifo queue
+// submit() hands back a future, exceptions thrown by the job come out of future.get()
+class ThreadPool {
+public:
+  ThreadPool() = default;
+  ~ThreadPool();
+  // 0 uses one thread per hardware thread
+  void init(uint32_t threadCount = 0);
+  // finishes the jobs already queued, then joins the workers
+  void cleanup();
+public:
+  uint32_t getThreadCount() const;
+
+  template<typename F>
+  auto submit(F job) -> std::future<decltype(job())> {
+    // std::function needs a copyable callable, the task is only movable
+    auto task = std::make_shared<std::packaged_task<decltype(job())()>>(std::move(job));
+    std::future<decltype(job())> future = task->get_future();
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _jobs.push_back([task]() { (*task)(); });
+    }
+    _jobAvailable.notify_one();
+    return future;
+  }
+private:
+  std::vector<std::thread> _threads;
+  std::deque<std::function<void()>> _jobs;
+  std::mutex _mutex;
+  std::condition_variable _jobAvailable;
+  bool _stopping = false;
+private:
+  void workerLoop();
+};
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include "SlotMap.hh"
+
+class RenderAssets;
+
+// one persistently mapped host visible buffer with a region per frame in flight,
+// bound once as a dynamic uniform buffer
+// every push() gets its own slice aligned to minUniformBufferOffsetAlignment, the returned
+// offset is passed as dynamic offset when binding, so per object data needs no descriptor set of its own
+class UniformRing {
+public:
+  UniformRing() = default;
+  ~UniformRing() = default;
+  // the buffer belongs to assets and is released with it
+  void init(RenderAssets* assets, vk::PhysicalDevice gpu, vk::DeviceSize frameSize, uint32_t framesInFlight);
+public:
+  // the frame's previous slices must no longer be in use, i.e. its fence has been waited on
+  void beginFrame(uint32_t frame);
+  uint32_t push(const void* data, vk::DeviceSize size);
+  template<typename T>
+  uint32_t push(const T& value) {
+    return push(&value, sizeof(T));
+  }
+public:
+  BufferHandle getBuffer() const;
+private:
+  RenderAssets* _assets = nullptr;
+  BufferHandle _buffer;
+  char* _mapped = nullptr;
+  vk::DeviceSize _alignment = 0;
+  vk::DeviceSize _frameSize = 0;
+  vk::DeviceSize _head = 0;
+  vk::DeviceSize _frameEnd = 0;
+};
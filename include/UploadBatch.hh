@@ -0,0 +1,90 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <deque>
+#include <vector>
+
+class StagingRing;
+
+// records many copies and layout transitions into one command buffer and submits them together
+// submit() returns a ticket, the caller only waits on it when it needs the data on the cpu side
+//
+// with a dedicated transfer family the batch runs on the transfer queue and releases every
+// resource it wrote, acquire() records the matching acquire barriers into a graphics command
+// buffer once the transfer has finished, so uploads never stall the frames rendered meanwhile
+// without one, work submitted later to the same queue sees the uploads through the closing barrier
+//
+// blits need a graphics queue, so mip chains of batches on the transfer queue are generated
+// by acquire() in the graphics command buffer right after the image has been acquired
+class UploadBatch {
+public:
+  UploadBatch() = default;
+  ~UploadBatch() = default;
+  void init(vk::Device device, vk::Queue queue, uint32_t queueFamily, uint32_t graphicsFamily, StagingRing* stagingRing);
+  void cleanup();
+public:
+  void copyBuffer(vk::Buffer src, vk::Buffer dst, const vk::BufferCopy& region);
+  void copyBufferToImage(vk::Buffer src, vk::Image dst, const vk::BufferImageCopy& region);
+  void transitionImageLayout(
+      vk::Image image, 
+      vk::ImageLayout oldLayout, 
+      vk::ImageLayout newLayout, 
+      uint32_t baseMipLevel = 0, 
+      uint32_t levelCount = VK_REMAINING_MIP_LEVELS
+      );
+  void generateMipmaps(vk::Image image, uint32_t width, uint32_t height, uint32_t mipLevels);
+
+  uint64_t submit();
+  void acquire(vk::CommandBuffer graphicsCommandBuffer);
+  bool isComplete(uint64_t ticket);
+  bool isReady(uint64_t ticket) const;
+  void wait(uint64_t ticket);
+private:
+  struct WrittenRange {
+    vk::Buffer buffer;
+    vk::DeviceSize offset;
+    vk::DeviceSize size;
+  };
+
+  struct Pending {
+    vk::CommandBuffer commandBuffer;
+    uint64_t ticket;
+  };
+
+  struct MipChain {
+    vk::Image image;
+    uint32_t width;
+    uint32_t height;
+    uint32_t mipLevels;
+  };
+
+  struct Acquire {
+    uint64_t ticket;
+    std::vector<vk::BufferMemoryBarrier> bufferBarriers;
+    std::vector<vk::ImageMemoryBarrier> imageBarriers;
+    std::vector<MipChain> mipChains;
+  };
+private:
+  vk::Device _device = nullptr;
+  vk::Queue _queue = nullptr;
+  vk::CommandPool _commandPool = nullptr;
+  uint32_t _queueFamily = 0;
+  uint32_t _graphicsFamily = 0;
+  StagingRing* _stagingRing = nullptr;
+private:
+  vk::CommandBuffer _recording = nullptr;
+  std::vector<Pending> _pending;
+  std::vector<vk::CommandBuffer> _freeCommandBuffers;
+
+  // ownership transfers of the batch being recorded and of submitted batches not acquired yet
+  std::vector<WrittenRange> _writtenRanges;
+  Acquire _recordingAcquire;
+  std::deque<Acquire> _acquires;
+  uint64_t _readyTicket = 0;
+private:
+  bool ownershipTransfer() const;
+  vk::CommandBuffer getRecordingBuffer();
+  void recycleCommandBuffers();
+  void recordMipChain(vk::CommandBuffer commandBuffer, const MipChain& chain);
+};
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include <vulkan/vulkan.hpp>
+
+// one vertex input attribute, T is the type it is stored as in the vertex struct
+template<typename T, vk::Format F>
+struct VertexAttribute {
+  using Type = T;
+  static constexpr vk::Format format = F;
+};
+
+// binding and attribute descriptions derived from the attribute list,
+// attributes are laid out in order, each one aligned to its storage type
+// the vertex struct declares its members in the same order, see the static_asserts next to Vertex
+template<typename... Attributes>
+struct VertexLayout {
+  static constexpr uint32_t attributeCount = sizeof...(Attributes);
+
+  static constexpr std::array<uint32_t, attributeCount> offsets() {
+    std::array<uint32_t, attributeCount> result{};
+    constexpr uint32_t sizes[] = { static_cast<uint32_t>(sizeof(typename Attributes::Type))... };
+    constexpr uint32_t alignments[] = { static_cast<uint32_t>(alignof(typename Attributes::Type))... };
+
+    uint32_t offset = 0;
+    for (uint32_t i = 0; i < attributeCount; i++) {
+      offset = (offset + alignments[i] - 1) / alignments[i] * alignments[i];
+      result[i] = offset;
+      offset += sizes[i];
+    }
+    return result;
+  }
+
+  // rounded up so consecutive vertices keep every attribute aligned
+  static constexpr uint32_t stride() {
+    constexpr uint32_t sizes[] = { static_cast<uint32_t>(sizeof(typename Attributes::Type))... };
+    constexpr uint32_t alignments[] = { static_cast<uint32_t>(alignof(typename Attributes::Type))... };
+
+    uint32_t alignment = 1;
+    for (uint32_t i = 0; i < attributeCount; i++) {
+      alignment = alignments[i] > alignment ? alignments[i] : alignment;
+    }
+    uint32_t end = offsets()[attributeCount - 1] + sizes[attributeCount - 1];
+    return (end + alignment - 1) / alignment * alignment;
+  }
+
+  static constexpr vk::VertexInputBindingDescription getBindingDescription(
+      uint32_t binding = 0,
+      vk::VertexInputRate inputRate = vk::VertexInputRate::eVertex) {
+    return vk::VertexInputBindingDescription(binding, stride(), inputRate);
+  }
+
+  static constexpr std::array<vk::VertexInputAttributeDescription, attributeCount> getAttributeDescriptions(
+      uint32_t binding = 0,
+      uint32_t firstLocation = 0) {
+    constexpr vk::Format formats[] = { Attributes::format... };
+    constexpr std::array<uint32_t, attributeCount> attributeOffsets = offsets();
+
+    std::array<vk::VertexInputAttributeDescription, attributeCount> descriptions{};
+    for (uint32_t i = 0; i < attributeCount; i++) {
+      descriptions[i] = vk::VertexInputAttributeDescription(firstLocation + i, binding, formats[i], attributeOffsets[i]);
+    }
+    return descriptions;
+  }
+};
@@ -1,33 +1,128 @@
-#include <optional>
 #include <vulkan/vulkan.hpp>
 
+#include <string>
+#include <vector>
+
+#include "SlotMap.hh"
+#include "Structs.hh"
+#include "ThreadPool.hh"
+#include "AsyncLoader.hh"
+#include "TextureImport.hh"
+#include "MeshImport.hh"
+#include "GeometryArena.hh"
+#include "UniformRing.hh"
+#include "ParallelRecorder.hh"
+
 class VulkanInstance;
 class RenderAssets;
 
+enum class DrawMode {
+  // one drawIndexed per mesh
+  eDirect,
+  // one indirect draw per geometry block, the commands are written to a buffer each frame
+  eIndirect,
+};
+
 class Renderer {
 public:
   Renderer() = default;
   ~Renderer() = default;
+  // .obj/.glb files to draw, the built in quad is drawn when none are set
+  void setMeshFiles(const std::vector<std::string>& files);
+  // every mesh is drawn once per instance in a single call, one identity instance when none are set
+  void setInstances(const std::vector<InstanceData>& instances);
+  void setDrawMode(DrawMode mode);
+  // indirect mode only, instances outside the view frustum are dropped by a compute pass
+  void setFrustumCulling(bool v);
+  // direct mode only, mesh draws are split across the thread pool into secondary command buffers
+  void setParallelRecording(bool v);
   void init(VulkanInstance* instance, RenderAssets* assets);
+  void cleanup();
   void drawFrame();
+  // every mesh file has been parsed and uploaded, until then drawFrame keeps adding them
+  bool isLoaded() const;
 private:
-  void updateUniformBuffer(uint32_t currentFrame);
-  void transitionImageLayout(vk::Image image, vk::Format format, vk::ImageLayout oldLayout, vk::ImageLayout newLayout);
+  uint32_t updateUniformBuffer();
 private:
   vk::Device _device;
   vk::PhysicalDevice _gpu;
 private:
-  std::optional<uint32_t> _vertexIndex;
-  std::optional<uint32_t> _indexIndex;
-  std::optional<uint32_t> _uniformIndex;
-  std::optional<uint32_t> _imageIndex;
-  void* _data;
+  struct Mesh {
+    GeometryRange geometry;
+    glm::vec4 bounds;
+    // always the first texture for now, so instance texture indices only have to be checked on their own
+    uint32_t materialIndex = 0;
+    // each mesh is drawn as soon as its own upload is ready
+    uint64_t uploadTicket = 0;
+  };
+  // everything sized by the mesh count, built again as meshes stream in
+  struct MeshBuffers {
+    // the meshes the buffers were built for, sorted by geometry block
+    std::vector<Mesh> meshes;
+    uint32_t blockCount = 0;
+    // per frame in flight: a command slot for every mesh, then a draw count for every block
+    BufferHandle indirectBuffer;
+    void* indirectData = nullptr;
+    // with culling, cull.comp copies the visible instances of mesh i to [i * instance count, ...)
+    BufferHandle boundsBuffer;
+    BufferHandle visibleInstanceBuffer;
+    uint64_t boundsTicket = 0;
+  };
+private:
+  DrawMode _drawMode = DrawMode::eIndirect;
+  bool _frustumCulling = true;
+  bool _parallelRecording = false;
+  std::vector<std::string> _meshFiles;
+  // every uploaded mesh, sorted by geometry block again whenever more arrive
+  std::vector<Mesh> _loadedMeshes;
+  GeometryArena _geometry;
+  // frames draw from _meshBuffers, the pending ones replace them once their bounds are uploaded
+  MeshBuffers _meshBuffers;
+  MeshBuffers _pendingMeshBuffers;
+  bool _hasPendingMeshBuffers = false;
+  std::vector<InstanceData> _instances;
+  BufferHandle _instanceBuffer;
+  uint64_t _instanceTicket = 0;
+  UniformRing _uniformRing;
+  // dynamic offset of this frame's UniformBufferObject
+  uint32_t _viewUniformOffset = 0;
+  // indexed by load order, which is also the texture's element of the bindless array
+  std::vector<ImageHandle> _textures;
+  uint64_t _uploadTicket = 0;
+  // pushed with every draw, the ubo only holds view and projection
+  glm::mat4 _model = glm::mat4(1.0f);
+  ThreadPool _threadPool;
+  // recording jobs get workers of their own, the frame waits on them and must not queue
+  // behind mesh and texture loads on _threadPool
+  ThreadPool _recordingPool;
+  ParallelRecorder _recorder;
+  AsyncLoader<TextureData> _textureLoader;
+  AsyncLoader<std::vector<MeshData>> _meshLoader;
 private:
   VulkanInstance* _instance;
   RenderAssets* _assets;
 private:
-  void createTextureImage();
-  void allocateVertexBuffer();
-  void allocateIndexBuffer();
+  void requestTextures();
+  void uploadTextures();
+  ImageHandle uploadTexture(const TextureData& texture);
+  void requestMeshes();
+  void uploadMeshes();
+  void uploadMesh(const MeshData& data);
+  void uploadInstances();
+  void allocateMeshBuffers(MeshBuffers* buffers);
+  void allocateIndirectBuffer(MeshBuffers* buffers);
+  void allocateCullBuffers(MeshBuffers* buffers);
+  void destroyMeshBuffers(const MeshBuffers& buffers);
+  void swapMeshBuffers();
+  void updateCullDescriptorSets();
   void allocateUniformBuffer();
+  void bindGeometryBlock(vk::CommandBuffer commandBuffer, uint32_t block);
+  void bindDrawState(vk::CommandBuffer commandBuffer, uint32_t currentFrame, bool culled);
+  void pushDrawConstants(vk::CommandBuffer commandBuffer, uint32_t materialIndex);
+  void recordDirectDraws(vk::CommandBuffer commandBuffer, uint32_t instanceCount, uint32_t firstMesh, uint32_t endMesh);
+  void recordParallelDraws(vk::CommandBuffer commandBuffer, uint32_t currentFrame, uint32_t imageIndex, uint32_t instanceCount);
+  void recordCulling(vk::CommandBuffer commandBuffer, uint32_t currentFrame, uint32_t instanceCount);
+  void recordIndirectDraws(vk::CommandBuffer commandBuffer, uint32_t currentFrame, uint32_t instanceCount, bool culled);
+  vk::DeviceSize getIndirectCommandsOffset(uint32_t frame) const;
+  vk::DeviceSize getIndirectCountsOffset(uint32_t frame) const;
 };
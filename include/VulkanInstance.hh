@@ -1,10 +1,20 @@
 #include <memory>
+#include <string>
+#include <vector>
 #include <vulkan/vulkan.hpp>
 
 struct QueueFamilyIndices;
+struct GpuPassTime;
 
 class GLFWwindow;
 
+enum class CommandResetMode {
+  // one pool created with eResetCommandBuffer, each frame's buffer is reset on its own
+  ePerBuffer,
+  // a transient pool per frame in flight, reset as a whole once the frame's fence has signaled
+  ePerFramePool,
+};
+
 class VulkanInstance{
 public:
   VulkanInstance() = default;
@@ -13,6 +23,11 @@ public:
   void cleanup();
   void currentFrameInc();
   void setWindow(GLFWwindow* w);
+  void setHeadless(uint32_t width, uint32_t height);
+  void setEnableValidationLayers(bool v);
+  void setFramesInFlight(uint32_t count);
+  void setEnableTransferQueue(bool v);
+  void setCommandResetMode(CommandResetMode mode);
 
   void setFrameBufferResized(bool v);
   void recreateSwapChain();
@@ -20,9 +35,18 @@ public:
   uint32_t acquireImage();
 public:
   uint32_t getCurrentFrame() const;
+  uint64_t getFrameCount() const;
+  uint32_t getFramesInFlight() const;
+  bool isHeadless() const;
   vk::PhysicalDevice getGPU() const;
+  const vk::PhysicalDeviceFeatures& getEnabledFeatures() const;
+  // VK_KHR_draw_indirect_count, nullptr when the device does not have it
+  PFN_vkCmdDrawIndexedIndirectCountKHR getDrawIndexedIndirectCount() const;
   vk::Device getLogicalDevice() const;
   vk::Queue getGraphicsQueue() const;
+  uint32_t getGraphicsQueueFamily() const;
+  vk::Queue getTransferQueue() const;
+  uint32_t getTransferQueueFamily() const;
   vk::Queue getPresentQueue() const;
   vk::Extent2D getSwapChainExtent() const;
   vk::Framebuffer getFramebuffer(uint32_t imageIndex) const;
@@ -32,26 +56,38 @@ public:
   vk::Semaphore getImageSemaphore(uint32_t index) const;
   vk::Semaphore getRenderSemaphore(uint32_t index) const;
   vk::Fence getFence(uint32_t index) const;
+  const std::vector<GpuPassTime>& getGpuPassTimes() const;
 public:
   void waitForFence() const;
-  vk::CommandBuffer getCommandBufferBegin() const;
+  vk::CommandBuffer getCommandBufferBegin();
   void getCommandBufferEnd() const;
   void applyGraphicsQueue() const;
   void applyPresentQueue(uint32_t imageIndex);
+public:
+  uint32_t beginTimestamp(vk::CommandBuffer commandBuffer, const std::string& passName);
+  void endTimestamp(vk::CommandBuffer commandBuffer, uint32_t pass);
 private:
   GLFWwindow* _window = nullptr;
 private:
   bool _enableValidationLayers = true;
+  bool _headless = false;
+  bool _enableTransferQueue = true;
+  CommandResetMode _commandResetMode = CommandResetMode::ePerFramePool;
   bool _frameBufferResized = false;
   uint32_t _currentFrame = 0;
+  uint64_t _frameCount = 0;
+  uint32_t _framesInFlight = 2;
   QueueFamilyIndices* _queueIndices = nullptr;
 private:
   vk::Instance _instance = nullptr;
   vk::SurfaceKHR _surface = nullptr;
   vk::PhysicalDevice _gpu = nullptr;
   vk::Device _device = nullptr;
+  vk::PhysicalDeviceFeatures _enabledFeatures;
+  PFN_vkCmdDrawIndexedIndirectCountKHR _drawIndexedIndirectCount = nullptr;
   vk::Queue _graphicsQueue = nullptr;
   vk::Queue _presentQueue = nullptr;
+  vk::Queue _transferQueue = nullptr;
 
   vk::SwapchainKHR _swapChain = nullptr;
   vk::Format _swapChainImageFormat;
@@ -60,17 +96,33 @@ private:
   std::vector<vk::Image> _swapChainImages;
   std::vector<vk::ImageView> _swapChainImageViews;
   std::vector<vk::Framebuffer> _swapChainFramebuffers;
+  std::vector<vk::DeviceMemory> _offscreenMemories;
 
   vk::RenderPass _renderPass;
 
   vk::DescriptorSetLayout _descriptorSetLayout = nullptr;
 
   vk::CommandPool _commandPool = nullptr;
+  // the buffer each frame in flight records into
   std::vector<vk::CommandBuffer> _commandBuffers;
+  struct FrameCommands {
+    vk::CommandPool pool = nullptr;
+    std::vector<vk::CommandBuffer> buffers;
+    // buffers before this one were handed out since the last reset
+    uint32_t next = 0;
+  };
+  // ePerFramePool only
+  std::vector<FrameCommands> _frameCommands;
   std::vector<vk::Semaphore> _imageAvailableSemaphores;
   std::vector<vk::Semaphore> _renderFinishedSemaphores;
   std::vector<vk::Fence> _inFlightFences;
 
+  vk::QueryPool _timestampPool = nullptr;
+  float _timestampPeriod = 0.0f;
+  uint64_t _timestampMask = 0;
+  std::vector<std::vector<std::string>> _timestampPassNames;
+  std::vector<GpuPassTime> _gpuPassTimes;
+
   std::vector<vk::Buffer> _uniformBuffers;
   std::vector<vk::DeviceMemory> _uniformMems;
   std::vector<void*> _uniformBuffersMapped;
@@ -83,16 +135,22 @@ private:
   void pickPhysicalDevice();
   void createLogicalDevice();
   void createSwapChain();
+  void createOffscreenImages();
   void createImageViews();
   void createRenderPass();
   void createFrameBuffers();
   void createCommandPool();
   void allocateCommandBuffers();
+  vk::CommandBuffer nextFrameCommandBuffer();
   void createSyncObjects();
+  void createTimestampQueryPool();
+  void resolveTimestamps(vk::CommandBuffer commandBuffer);
 private:
   void cleanupSwapChain();
+  void cleanupOffscreenImages();
   void cleanupRenderPass();
   void cleanupSyncObjects();
+  void cleanupTimestampQueryPool();
   void cleanupCommandPool();
   void cleanupLogicalDevice();
   void cleanupSurface();
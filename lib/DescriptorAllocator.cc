@@ -0,0 +1,190 @@
+#include "DescriptorAllocator.hh"
+
+#include "Macros.hh"
+
+// a set cache key is the layout followed by these words for every binding
+enum KeyField : uint32_t {
+  eKeyBinding,
+  eKeyType,
+  eKeyBuffer,
+  eKeyOffset,
+  eKeyRange,
+  eKeyImageView,
+  eKeySampler,
+  eKeyImageLayout,
+  eKeyFieldCount,
+};
+
+void DescriptorAllocator::init(vk::Device device) {
+  _device = device;
+}
+
+void DescriptorAllocator::cleanup() {
+  for (auto& [layout, chain] : _chains) {
+    destroyChain(&chain);
+  }
+  _chains.clear();
+  _setCache.clear();
+  _freeSets.clear();
+  _layouts.clear();
+}
+
+void DescriptorAllocator::registerLayout(
+    vk::DescriptorSetLayout layout,
+    const std::vector<vk::DescriptorPoolSize>& setSizes,
+    uint32_t firstPoolSets,
+    vk::DescriptorPoolCreateFlags flags) {
+  LayoutInfo info;
+  info.setSizes = setSizes;
+  info.firstPoolSets = firstPoolSets;
+  info.flags = flags;
+  _layouts[static_cast<VkDescriptorSetLayout>(layout)] = info;
+}
+
+vk::DescriptorSet DescriptorAllocator::allocate(vk::DescriptorSetLayout layout) {
+  return allocateFromChain(layout, &_chains[static_cast<VkDescriptorSetLayout>(layout)]);
+}
+
+vk::DescriptorSet DescriptorAllocator::getOrCreate(vk::DescriptorSetLayout layout, const std::vector<DescriptorBinding>& bindings) {
+  std::vector<uint64_t> key(1 + bindings.size() * eKeyFieldCount);
+  key[0] = (uint64_t)static_cast<VkDescriptorSetLayout>(layout);
+  for (size_t i = 0; i < bindings.size(); i++) {
+    uint64_t* words = key.data() + 1 + i * eKeyFieldCount;
+    words[eKeyBinding] = bindings[i].binding;
+    words[eKeyType] = static_cast<uint64_t>(bindings[i].type);
+    words[eKeyBuffer] = (uint64_t)static_cast<VkBuffer>(bindings[i].buffer);
+    words[eKeyOffset] = bindings[i].offset;
+    words[eKeyRange] = bindings[i].range;
+    words[eKeyImageView] = (uint64_t)static_cast<VkImageView>(bindings[i].imageView);
+    words[eKeySampler] = (uint64_t)static_cast<VkSampler>(bindings[i].sampler);
+    words[eKeyImageLayout] = static_cast<uint64_t>(bindings[i].imageLayout);
+  }
+
+  auto it = _setCache.find(key);
+  if (it != _setCache.end()) {
+    return it->second;
+  }
+
+  // evicted sets of the same layout are rewritten before new ones are allocated
+  vk::DescriptorSet set;
+  std::vector<vk::DescriptorSet>& freeSets = _freeSets[static_cast<VkDescriptorSetLayout>(layout)];
+  if (freeSets.empty()) {
+    set = allocate(layout);
+  } else {
+    set = freeSets.back();
+    freeSets.pop_back();
+  }
+  writeSet(set, bindings);
+  _setCache.emplace(std::move(key), set);
+  return set;
+}
+
+void DescriptorAllocator::evict(vk::Buffer buffer) {
+  evictHandle((uint64_t)static_cast<VkBuffer>(buffer), eKeyBuffer);
+}
+
+void DescriptorAllocator::evict(vk::ImageView imageView) {
+  evictHandle((uint64_t)static_cast<VkImageView>(imageView), eKeyImageView);
+}
+
+// handles are released only after the frames that used them are done, so the set
+// can go straight to the free list of its layout
+void DescriptorAllocator::evictHandle(uint64_t handle, uint32_t keyField) {
+  for (auto it = _setCache.begin(); it != _setCache.end();) {
+    const std::vector<uint64_t>& key = it->first;
+    bool refers = false;
+    for (size_t word = 1 + keyField; word < key.size(); word += eKeyFieldCount) {
+      refers = refers || key[word] == handle;
+    }
+    if (!refers) {
+      it++;
+      continue;
+    }
+    _freeSets[(VkDescriptorSetLayout)key[0]].push_back(it->second);
+    it = _setCache.erase(it);
+  }
+}
+
+// moves on to the next pool when the current one is out of space, every pool is twice
+// as large as the one before it
+vk::DescriptorSet DescriptorAllocator::allocateFromChain(vk::DescriptorSetLayout layout, PoolChain* chain) {
+  auto info = _layouts.find(static_cast<VkDescriptorSetLayout>(layout));
+  IF_THROW(
+      info == _layouts.end(),
+      descriptor set layout was not registered with the allocator...
+      );
+
+  vk::DescriptorSetAllocateInfo allocInfo;
+  allocInfo.setSetLayouts(layout);
+
+  while (true) {
+    bool created = false;
+    if (chain->current == chain->pools.size()) {
+      chain->pools.push_back(createPool(info->second, info->second.firstPoolSets << chain->current));
+      created = true;
+    }
+    allocInfo.setDescriptorPool(chain->pools[chain->current]);
+
+    try {
+      return _device.allocateDescriptorSets(allocInfo)[0];
+    } catch (vk::OutOfPoolMemoryError&) {
+      if (created) throw;
+    } catch (vk::FragmentedPoolError&) {
+      if (created) throw;
+    }
+    chain->current++;
+  }
+}
+
+vk::DescriptorPool DescriptorAllocator::createPool(const LayoutInfo& info, uint32_t maxSets) {
+  std::vector<vk::DescriptorPoolSize> poolSizes = info.setSizes;
+  for (auto& poolSize : poolSizes) {
+    poolSize.setDescriptorCount(poolSize.descriptorCount * maxSets);
+  }
+
+  vk::DescriptorPoolCreateInfo createInfo;
+  createInfo.setFlags(info.flags)
+            .setPoolSizes(poolSizes)
+            .setMaxSets(maxSets);
+
+  vk::DescriptorPool pool = _device.createDescriptorPool(createInfo);
+  CHECK_NULL(pool);
+  return pool;
+}
+
+void DescriptorAllocator::writeSet(vk::DescriptorSet set, const std::vector<DescriptorBinding>& bindings) {
+  // reserved so the info pointers stay valid while the writes are built
+  std::vector<vk::DescriptorBufferInfo> bufferInfos;
+  std::vector<vk::DescriptorImageInfo> imageInfos;
+  bufferInfos.reserve(bindings.size());
+  imageInfos.reserve(bindings.size());
+
+  std::vector<vk::WriteDescriptorSet> descriptorWrites;
+  for (const auto& binding : bindings) {
+    vk::WriteDescriptorSet write;
+    write.setDstSet(set)
+         .setDstBinding(binding.binding)
+         .setDstArrayElement(0)
+         .setDescriptorType(binding.type)
+         .setDescriptorCount(1);
+
+    if (binding.imageView || binding.sampler) {
+      imageInfos.push_back(vk::DescriptorImageInfo(binding.sampler, binding.imageView, binding.imageLayout));
+      write.setPImageInfo(&imageInfos.back());
+    } else {
+      bufferInfos.push_back(vk::DescriptorBufferInfo(binding.buffer, binding.offset, binding.range));
+      write.setPBufferInfo(&bufferInfos.back());
+    }
+    descriptorWrites.push_back(write);
+  }
+
+  _device.updateDescriptorSets(descriptorWrites.size(), descriptorWrites.data(), 0, nullptr);
+}
+
+void DescriptorAllocator::destroyChain(PoolChain* chain) {
+  for (auto pool : chain->pools) {
+    _device.destroyDescriptorPool(pool);
+  }
+  chain->pools.clear();
+  chain->current = 0;
+}
@@ -0,0 +1,84 @@
+#include "GeometryArena.hh"
+
+#include <algorithm>
+
+#include "RenderAssets.hh"
+#include "MeshImport.hh"
+#include "Structs.hh"
+
+void GeometryArena::init(RenderAssets* assets, vk::DeviceSize blockSize) {
+  _assets = assets;
+  _blockSize = blockSize;
+  _blocks.clear();
+}
+
+GeometryRange GeometryArena::add(const MeshData& mesh) {
+  vk::DeviceSize vertexSize = sizeof(Vertex) * mesh.vertices.size();
+  vk::DeviceSize indexSize = mesh.indices.size();
+  vk::DeviceSize indexStride = mesh.indexType == vk::IndexType::eUint16 ? sizeof(uint16_t) : sizeof(uint32_t);
+
+  uint32_t blockIndex = findBlock(mesh.indexType, vertexSize, indexSize);
+  Block& block = _blocks[blockIndex];
+
+  GeometryRange range;
+  range.block = blockIndex;
+  range.indexCount = mesh.indexCount;
+  range.firstIndex = static_cast<uint32_t>(block.indexUsed / indexStride);
+  range.vertexOffset = static_cast<int32_t>(block.vertexUsed / sizeof(Vertex));
+
+  _assets->uploadBuffer(block.vertexBuffer, mesh.vertices.data(), vertexSize, block.vertexUsed);
+  _assets->uploadBuffer(block.indexBuffer, mesh.indices.data(), indexSize, block.indexUsed);
+
+  block.vertexUsed += vertexSize;
+  block.indexUsed += indexSize;
+
+  return range;
+}
+
+uint32_t GeometryArena::getBlockCount() const {
+  return static_cast<uint32_t>(_blocks.size());
+}
+
+vk::Buffer GeometryArena::getVertexBuffer(uint32_t block) const {
+  return _assets->getBuffer(_blocks[block].vertexBuffer);
+}
+
+vk::Buffer GeometryArena::getIndexBuffer(uint32_t block) const {
+  return _assets->getBuffer(_blocks[block].indexBuffer);
+}
+
+vk::IndexType GeometryArena::getIndexType(uint32_t block) const {
+  return _blocks[block].indexType;
+}
+
+// first block of the right index type with room for both parts, a new one otherwise
+uint32_t GeometryArena::findBlock(vk::IndexType indexType, vk::DeviceSize vertexSize, vk::DeviceSize indexSize) {
+  for (uint32_t i = 0; i < _blocks.size(); i++) {
+    const Block& block = _blocks[i];
+    if (block.indexType == indexType &&
+        block.vertexUsed + vertexSize <= block.vertexCapacity &&
+        block.indexUsed + indexSize <= block.indexCapacity) {
+      return i;
+    }
+  }
+
+  Block block;
+  block.indexType = indexType;
+  block.vertexCapacity = std::max(_blockSize, vertexSize);
+  block.vertexUsed = 0;
+  block.indexCapacity = std::max(_blockSize, indexSize);
+  block.indexUsed = 0;
+
+  block.vertexBuffer = _assets->createBuffer(
+      block.vertexCapacity, 
+      vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eTransferDst, 
+      vk::MemoryPropertyFlagBits::eDeviceLocal);
+
+  block.indexBuffer = _assets->createBuffer(
+      block.indexCapacity, 
+      vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eTransferDst, 
+      vk::MemoryPropertyFlagBits::eDeviceLocal);
+
+  _blocks.push_back(block);
+  return static_cast<uint32_t>(_blocks.size() - 1);
+}
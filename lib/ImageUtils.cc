@@ -0,0 +1,95 @@
+#include "ImageUtils.hh"
+
+#include <algorithm>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace myUtils {
+
+  uint32_t mipLevelCount(uint32_t width, uint32_t height) {
+    uint32_t levels = 1;
+    uint32_t size = std::max(width, height);
+    while (size > 1) {
+      size /= 2;
+      levels++;
+    }
+    return levels;
+  }
+
+  // averages the stored values, srgb data is filtered without linearizing it first
+  void downsample(const uint8_t* src, uint32_t width, uint32_t height, uint32_t channels, uint8_t* dst) {
+    uint32_t dstWidth = std::max(width / 2, 1u);
+    uint32_t dstHeight = std::max(height / 2, 1u);
+
+    for (uint32_t y = 0; y < dstHeight; y++) {
+      const uint8_t* row0 = src + static_cast<size_t>(std::min(y * 2, height - 1)) * width * channels;
+      const uint8_t* row1 = src + static_cast<size_t>(std::min(y * 2 + 1, height - 1)) * width * channels;
+      uint8_t* out = dst + static_cast<size_t>(y) * dstWidth * channels;
+
+      uint32_t x = 0;
+
+#if defined(__SSE2__)
+      // 4 rgba output pixels from 8 pixels of each source row
+      const __m128i zero = _mm_setzero_si128();
+      const __m128i two = _mm_set1_epi16(2);
+      for (; channels == 4 && x + 4 <= dstWidth && x * 2 + 8 <= width; x += 4) {
+        __m128 a0 = _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + x * 8)));
+        __m128 a1 = _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + x * 8 + 16)));
+        __m128 b0 = _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + x * 8)));
+        __m128 b1 = _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + x * 8 + 16)));
+
+        // split even and odd pixels so each lane holds one side of a 2x2 block
+        __m128i aEven = _mm_castps_si128(_mm_shuffle_ps(a0, a1, _MM_SHUFFLE(2, 0, 2, 0)));
+        __m128i aOdd = _mm_castps_si128(_mm_shuffle_ps(a0, a1, _MM_SHUFFLE(3, 1, 3, 1)));
+        __m128i bEven = _mm_castps_si128(_mm_shuffle_ps(b0, b1, _MM_SHUFFLE(2, 0, 2, 0)));
+        __m128i bOdd = _mm_castps_si128(_mm_shuffle_ps(b0, b1, _MM_SHUFFLE(3, 1, 3, 1)));
+
+        __m128i lo = _mm_add_epi16(
+            _mm_add_epi16(_mm_unpacklo_epi8(aEven, zero), _mm_unpacklo_epi8(aOdd, zero)), 
+            _mm_add_epi16(_mm_unpacklo_epi8(bEven, zero), _mm_unpacklo_epi8(bOdd, zero))
+            );
+        __m128i hi = _mm_add_epi16(
+            _mm_add_epi16(_mm_unpackhi_epi8(aEven, zero), _mm_unpackhi_epi8(aOdd, zero)), 
+            _mm_add_epi16(_mm_unpackhi_epi8(bEven, zero), _mm_unpackhi_epi8(bOdd, zero))
+            );
+        lo = _mm_srli_epi16(_mm_add_epi16(lo, two), 2);
+        hi = _mm_srli_epi16(_mm_add_epi16(hi, two), 2);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x * 4), _mm_packus_epi16(lo, hi));
+      }
+#endif
+
+      for (; x < dstWidth; x++) {
+        uint32_t x0 = std::min(x * 2, width - 1);
+        uint32_t x1 = std::min(x * 2 + 1, width - 1);
+        for (uint32_t c = 0; c < channels; c++) {
+          uint32_t sum = row0[x0 * channels + c] + row0[x1 * channels + c] + row1[x0 * channels + c] + row1[x1 * channels + c];
+          out[x * channels + c] = static_cast<uint8_t>((sum + 2) / 4);
+        }
+      }
+    }
+  }
+
+  std::vector<std::vector<uint8_t>> generateMipChain(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t channels) {
+    std::vector<std::vector<uint8_t>> levels;
+    uint32_t levelCount = mipLevelCount(width, height);
+
+    const uint8_t* src = pixels;
+    for (uint32_t i = 1; i < levelCount; i++) {
+      uint32_t dstWidth = std::max(width / 2, 1u);
+      uint32_t dstHeight = std::max(height / 2, 1u);
+
+      levels.emplace_back(static_cast<size_t>(dstWidth) * dstHeight * channels);
+      downsample(src, width, height, channels, levels.back().data());
+
+      src = levels.back().data();
+      width = dstWidth;
+      height = dstHeight;
+    }
+
+    return levels;
+  }
+
+};
@@ -0,0 +1,219 @@
+#include "MemoryAllocator.hh"
+
+#include <algorithm>
+
+#include "VkUtils.hh"
+#include "Macros.hh"
+
+static vk::DeviceSize alignUp(vk::DeviceSize value, vk::DeviceSize alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+void MemoryAllocator::init(vk::Device device, vk::PhysicalDevice gpu) {
+  _device = device;
+  _gpu = gpu;
+  _granularity = std::max<vk::DeviceSize>(_gpu.getProperties().limits.bufferImageGranularity, 1);
+  _memoryProperties = _gpu.getMemoryProperties();
+  _blocks.resize(_memoryProperties.memoryTypeCount);
+}
+
+void MemoryAllocator::cleanup() {
+  for (auto& blocks : _blocks) {
+    for (auto& block : blocks) {
+      releaseBlock(block);
+    }
+  }
+  _blocks.clear();
+}
+
+MemoryAllocation MemoryAllocator::allocate(
+    const vk::MemoryRequirements& requirements,
+    vk::MemoryPropertyFlags memoryProp,
+    bool linear) {
+  MemoryAllocation allocation;
+  allocation.memoryType = myUtils::findMemType(requirements.memoryTypeBits, memoryProp, _gpu);
+  allocation.size = requirements.size;
+
+  std::vector<Block>& blocks = _blocks[allocation.memoryType];
+
+  for (uint32_t i = 0; i < blocks.size(); i++) {
+    if (!blocks[i].memory) continue;
+    if (allocateFromBlock(blocks[i], requirements.size, requirements.alignment, linear, &allocation.offset)) {
+      allocation.memory = blocks[i].memory;
+      allocation.block = i;
+      return allocation;
+    }
+  }
+
+  // resources bigger than a block get a block of their own
+  vk::DeviceSize blockSize = std::max(preferredBlockSize(allocation.memoryType), alignUp(requirements.size, _granularity));
+  allocation.block = createBlock(allocation.memoryType, blockSize);
+
+  Block& block = blocks[allocation.block];
+  bool result = allocateFromBlock(block, requirements.size, requirements.alignment, linear, &allocation.offset);
+  IF_THROW(
+      !result,
+      failed to allocate from a fresh memory block...
+      );
+  allocation.memory = block.memory;
+
+  return allocation;
+}
+
+void MemoryAllocator::free(const MemoryAllocation& allocation) {
+  if (!allocation.memory) return;
+
+  std::vector<Block>& blocks = _blocks[allocation.memoryType];
+  Block& block = blocks[allocation.block];
+
+  auto it = block.ranges.find(allocation.offset);
+  IF_THROW(
+      it == block.ranges.end() || it->second.free,
+      freeing memory that is not allocated...
+      );
+  it->second.free = true;
+  block.allocationCount--;
+
+  auto next = std::next(it);
+  if (next != block.ranges.end() && next->second.free) {
+    it->second.size += next->second.size;
+    block.ranges.erase(next);
+  }
+  if (it != block.ranges.begin()) {
+    auto prev = std::prev(it);
+    if (prev->second.free) {
+      prev->second.size += it->second.size;
+      block.ranges.erase(it);
+    }
+  }
+
+  // keep one empty block per memory type around so alloc/free churn does not hit the driver
+  if (block.allocationCount == 0) {
+    for (uint32_t i = 0; i < blocks.size(); i++) {
+      if (i != allocation.block && blocks[i].memory && blocks[i].allocationCount == 0) {
+        releaseBlock(block);
+        break;
+      }
+    }
+  }
+}
+
+void* MemoryAllocator::map(const MemoryAllocation& allocation) {
+  Block& block = _blocks[allocation.memoryType][allocation.block];
+  if (!block.mapped) {
+    IF_THROW(
+        _device.mapMemory(block.memory, 0, VK_WHOLE_SIZE, vk::MemoryMapFlags(0), &block.mapped) != vk::Result::eSuccess,
+        trouble mapping memory block
+        );
+  }
+  return static_cast<char*>(block.mapped) + allocation.offset;
+}
+
+MemoryStats MemoryAllocator::getStats() const {
+  MemoryStats stats;
+  vk::DeviceSize bytesFree = 0;
+
+  for (const auto& blocks : _blocks) {
+    for (const auto& block : blocks) {
+      if (!block.memory) continue;
+      stats.blockCount++;
+      stats.bytesReserved += block.size;
+      stats.allocationCount += block.allocationCount;
+      for (const auto& [offset, range] : block.ranges) {
+        if (range.free) {
+          bytesFree += range.size;
+          stats.largestFreeRange = std::max(stats.largestFreeRange, range.size);
+        } else {
+          stats.bytesInUse += range.size;
+        }
+      }
+    }
+  }
+
+  if (bytesFree > 0) {
+    stats.fragmentation = 1.0f - static_cast<float>(stats.largestFreeRange) / static_cast<float>(bytesFree);
+  }
+
+  return stats;
+}
+
+// first-fit, the pages around the range are checked against bufferImageGranularity
+// free ranges are always merged, so the neighbours of a free range are in use
+bool MemoryAllocator::allocateFromBlock(Block& block, vk::DeviceSize size, vk::DeviceSize alignment, bool linear, vk::DeviceSize* offset) {
+  for (auto it = block.ranges.begin(); it != block.ranges.end(); it++) {
+    if (!it->second.free) continue;
+
+    vk::DeviceSize rangeBegin = it->first;
+    vk::DeviceSize rangeEnd = it->first + it->second.size;
+    vk::DeviceSize begin = alignUp(rangeBegin, std::max<vk::DeviceSize>(alignment, 1));
+
+    if (it != block.ranges.begin()) {
+      auto prev = std::prev(it);
+      vk::DeviceSize prevLast = prev->first + prev->second.size - 1;
+      if (prev->second.linear != linear && prevLast / _granularity == begin / _granularity) {
+        begin = alignUp(begin, _granularity);
+      }
+    }
+
+    vk::DeviceSize end = begin + size;
+    if (end > rangeEnd) continue;
+
+    auto next = std::next(it);
+    if (next != block.ranges.end() && next->second.linear != linear && (end - 1) / _granularity == next->first / _granularity) {
+      continue;
+    }
+
+    block.ranges.erase(it);
+    if (begin > rangeBegin) {
+      block.ranges[rangeBegin] = { begin - rangeBegin, true, false };
+    }
+    block.ranges[begin] = { size, false, linear };
+    if (end < rangeEnd) {
+      block.ranges[end] = { rangeEnd - end, true, false };
+    }
+
+    block.allocationCount++;
+    *offset = begin;
+    return true;
+  }
+  return false;
+}
+
+uint32_t MemoryAllocator::createBlock(uint32_t memoryType, vk::DeviceSize size) {
+  vk::MemoryAllocateInfo allocInfo;
+  allocInfo.setAllocationSize(size)
+           .setMemoryTypeIndex(memoryType);
+
+  Block block;
+  block.memory = _device.allocateMemory(allocInfo);
+  CHECK_NULL(block.memory);
+  block.size = size;
+  block.ranges[0] = { size, true, false };
+
+  // reuse the slot of a released block so indices held by allocations stay valid
+  std::vector<Block>& blocks = _blocks[memoryType];
+  for (uint32_t i = 0; i < blocks.size(); i++) {
+    if (!blocks[i].memory) {
+      blocks[i] = std::move(block);
+      return i;
+    }
+  }
+  blocks.push_back(std::move(block));
+  return static_cast<uint32_t>(blocks.size() - 1);
+}
+
+void MemoryAllocator::releaseBlock(Block& block) {
+  if (!block.memory) return;
+  if (block.mapped) {
+    _device.unmapMemory(block.memory);
+  }
+  _device.freeMemory(block.memory);
+  block = Block();
+}
+
+// small heaps (integrated gpus, bar memory) get smaller blocks
+vk::DeviceSize MemoryAllocator::preferredBlockSize(uint32_t memoryType) const {
+  uint32_t heapIndex = _memoryProperties.memoryTypes[memoryType].heapIndex;
+  vk::DeviceSize heapSize = _memoryProperties.memoryHeaps[heapIndex].size;
+  return std::max<vk::DeviceSize>(std::min<vk::DeviceSize>(MEMORY_BLOCK_SIZE, heapSize / 8), 1024 * 1024);
+}
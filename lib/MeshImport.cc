@@ -0,0 +1,572 @@
+#include "MeshImport.hh"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <unordered_map>
+
+#include <glm/gtc/packing.hpp>
+
+#include "VkUtils.hh"
+#include "Macros.hh"
+
+// just enough json for the gltf header of a .glb
+struct JsonValue {
+  enum class Type { eNull, eBool, eNumber, eString, eArray, eObject };
+
+  Type type = Type::eNull;
+  bool boolean = false;
+  double number = 0.0;
+  std::string string;
+  // array elements, or object members together with keys
+  std::vector<JsonValue> values;
+  std::vector<std::string> keys;
+
+  const JsonValue* find(const std::string& key) const {
+    for (size_t i = 0; i < keys.size(); i++) {
+      if (keys[i] == key) return &values[i];
+    }
+    return nullptr;
+  }
+
+  double numberOr(const std::string& key, double fallback) const {
+    const JsonValue* value = find(key);
+    return value && value->type == Type::eNumber ? value->number : fallback;
+  }
+
+  const JsonValue& at(size_t index) const {
+    IF_THROW(
+        type != Type::eArray || index >= values.size(),
+        gltf index out of range...
+        );
+    return values[index];
+  }
+};
+
+class JsonParser {
+public:
+  JsonParser(const char* begin, const char* end) : _p(begin), _end(end) {}
+
+  JsonValue parse() {
+    JsonValue value = parseValue();
+    skipSpace();
+    IF_THROW(
+        _p != _end,
+        trailing characters after json...
+        );
+    return value;
+  }
+private:
+  const char* _p;
+  const char* _end;
+private:
+  void skipSpace() {
+    while (_p < _end && (*_p == ' ' || *_p == '\t' || *_p == '\n' || *_p == '\r')) _p++;
+  }
+
+  void expect(char c) {
+    skipSpace();
+    IF_THROW(
+        _p >= _end || *_p != c,
+        malformed json...
+        );
+    _p++;
+  }
+
+  bool consume(const char* word) {
+    size_t length = strlen(word);
+    if (static_cast<size_t>(_end - _p) < length || strncmp(_p, word, length) != 0) return false;
+    _p += length;
+    return true;
+  }
+
+  JsonValue parseValue() {
+    skipSpace();
+    IF_THROW(
+        _p >= _end,
+        unexpected end of json...
+        );
+
+    JsonValue value;
+    if (*_p == '{') {
+      value.type = JsonValue::Type::eObject;
+      _p++;
+      skipSpace();
+      if (_p < _end && *_p == '}') {
+        _p++;
+        return value;
+      }
+      do {
+        skipSpace();
+        value.keys.push_back(parseString());
+        expect(':');
+        value.values.push_back(parseValue());
+        skipSpace();
+      } while (_p < _end && *_p == ',' && ++_p);
+      expect('}');
+    } else if (*_p == '[') {
+      value.type = JsonValue::Type::eArray;
+      _p++;
+      skipSpace();
+      if (_p < _end && *_p == ']') {
+        _p++;
+        return value;
+      }
+      do {
+        value.values.push_back(parseValue());
+        skipSpace();
+      } while (_p < _end && *_p == ',' && ++_p);
+      expect(']');
+    } else if (*_p == '"') {
+      value.type = JsonValue::Type::eString;
+      value.string = parseString();
+    } else if (consume("true")) {
+      value.type = JsonValue::Type::eBool;
+      value.boolean = true;
+    } else if (consume("false")) {
+      value.type = JsonValue::Type::eBool;
+    } else if (consume("null")) {
+    } else {
+      // the chunk is not null terminated, copy the number out before strtod
+      const char* begin = _p;
+      while (_p < _end && strchr("+-0123456789.eE", *_p)) _p++;
+      IF_THROW(
+          _p == begin,
+          malformed json...
+          );
+      value.type = JsonValue::Type::eNumber;
+      value.number = strtod(std::string(begin, _p).c_str(), nullptr);
+    }
+    return value;
+  }
+
+  // escapes are kept simple, \u outside ascii becomes '?'
+  std::string parseString() {
+    expect('"');
+    std::string result;
+    while (_p < _end && *_p != '"') {
+      if (*_p == '\\' && _p + 1 < _end) {
+        _p++;
+        switch (*_p) {
+          case 'b': result += '\b'; break;
+          case 'f': result += '\f'; break;
+          case 'n': result += '\n'; break;
+          case 'r': result += '\r'; break;
+          case 't': result += '\t'; break;
+          case 'u': {
+            IF_THROW(
+                _end - _p < 5,
+                malformed json string escape...
+                );
+            unsigned long code = strtoul(std::string(_p + 1, _p + 5).c_str(), nullptr, 16);
+            result += code < 0x80 ? static_cast<char>(code) : '?';
+            _p += 4;
+            break;
+          }
+          default: result += *_p; break;
+        }
+      } else {
+        result += *_p;
+      }
+      _p++;
+    }
+    expect('"');
+    return result;
+  }
+};
+
+static bool hasExtension(const std::string& filename, const char* extension) {
+  size_t length = strlen(extension);
+  if (filename.size() < length) return false;
+  for (size_t i = 0; i < length; i++) {
+    if (tolower(filename[filename.size() - length + i]) != extension[i]) return false;
+  }
+  return true;
+}
+
+// obj indices are 1 based, negative ones count back from the last element so far
+static int64_t resolveObjIndex(long index, size_t count) {
+  if (index > 0) return index - 1;
+  if (index < 0) return static_cast<int64_t>(count) + index;
+  return -1;
+}
+
+static std::vector<MeshData> importObj(const std::vector<char>& file) {
+  std::vector<glm::vec3> positions;
+  std::vector<glm::vec3> colors;
+  std::vector<glm::vec2> texCoords;
+
+  std::vector<Vertex> vertices;
+  std::vector<uint32_t> indices;
+  // position and texcoord index pairs already turned into a vertex
+  std::unordered_map<uint64_t, uint32_t> vertexIds;
+
+  std::string text(file.begin(), file.end());
+  size_t lineBegin = 0;
+  std::vector<uint32_t> face;
+
+  while (lineBegin < text.size()) {
+    size_t lineEnd = text.find('\n', lineBegin);
+    if (lineEnd == std::string::npos) lineEnd = text.size();
+    std::string line = text.substr(lineBegin, lineEnd - lineBegin);
+    lineBegin = lineEnd + 1;
+
+    const char* c = line.c_str();
+    char* next;
+    if (line.compare(0, 2, "v ") == 0) {
+      glm::vec3 position, color(1.0f);
+      c += 2;
+      for (int i = 0; i < 3; i++) {
+        position[i] = strtof(c, &next);
+        c = next;
+      }
+      // optional per vertex color extension
+      float r = strtof(c, &next);
+      if (next != c) {
+        color.r = r;
+        c = next;
+        color.g = strtof(c, &next);
+        c = next;
+        color.b = strtof(c, &next);
+      }
+      positions.push_back(position);
+      colors.push_back(color);
+    } else if (line.compare(0, 3, "vt ") == 0) {
+      glm::vec2 texCoord;
+      c += 3;
+      texCoord.x = strtof(c, &next);
+      c = next;
+      // obj puts v = 0 at the bottom
+      texCoord.y = 1.0f - strtof(next, &next);
+      texCoords.push_back(texCoord);
+    } else if (line.compare(0, 2, "f ") == 0) {
+      face.clear();
+      c += 2;
+      while (true) {
+        long positionIndex = strtol(c, &next, 10);
+        if (next == c) break;
+        c = next;
+        long texCoordIndex = 0;
+        if (*c == '/') {
+          c++;
+          if (*c != '/') {
+            texCoordIndex = strtol(c, &next, 10);
+            c = next;
+          }
+          if (*c == '/') {
+            c++;
+            strtol(c, &next, 10);
+            c = next;
+          }
+        }
+
+        int64_t position = resolveObjIndex(positionIndex, positions.size());
+        int64_t texCoord = resolveObjIndex(texCoordIndex, texCoords.size());
+        IF_THROW(
+            position < 0 || position >= static_cast<int64_t>(positions.size()) || texCoord >= static_cast<int64_t>(texCoords.size()),
+            obj face index out of range...
+            );
+
+        uint64_t key = static_cast<uint64_t>(position) << 32 | static_cast<uint32_t>(texCoord);
+        auto found = vertexIds.find(key);
+        if (found == vertexIds.end()) {
+          glm::vec2 uv = texCoord >= 0 ? texCoords[texCoord] : glm::vec2(0.0f);
+          found = vertexIds.emplace(key, static_cast<uint32_t>(vertices.size())).first;
+          vertices.push_back(Vertex::pack(positions[position], colors[position], uv));
+        }
+        face.push_back(found->second);
+      }
+
+      // polygons are fanned into triangles
+      for (size_t i = 2; i < face.size(); i++) {
+        indices.push_back(face[0]);
+        indices.push_back(face[i - 1]);
+        indices.push_back(face[i]);
+      }
+    }
+  }
+
+  IF_THROW(
+      indices.empty(),
+      obj has no faces...
+      );
+
+  MeshData mesh;
+  mesh.vertices = std::move(vertices);
+  myUtils::packIndices(indices, static_cast<uint32_t>(mesh.vertices.size()), &mesh);
+  return { std::move(mesh) };
+}
+
+struct GltfAccessor {
+  const uint8_t* data = nullptr;
+  uint32_t count = 0;
+  uint32_t components = 0;
+  uint32_t componentType = 0;
+  uint32_t stride = 0;
+  bool normalized = false;
+};
+
+static uint32_t gltfComponentSize(uint32_t componentType) {
+  switch (componentType) {
+    case 5120: case 5121: return 1;
+    case 5122: case 5123: return 2;
+    case 5125: case 5126: return 4;
+  }
+  throw std::runtime_error("unknown gltf component type");
+}
+
+static uint32_t gltfComponentCount(const std::string& type) {
+  if (type == "SCALAR") return 1;
+  if (type == "VEC2") return 2;
+  if (type == "VEC3") return 3;
+  if (type == "VEC4") return 4;
+  throw std::runtime_error("unsupported gltf accessor type " + type);
+}
+
+// resolves the accessor's buffer view into the bin chunk, everything is bounds checked here
+static GltfAccessor getGltfAccessor(const JsonValue& json, uint32_t index, const std::vector<uint8_t>& bin) {
+  const JsonValue& accessor = json.find("accessors")->at(index);
+  IF_THROW(
+      accessor.find("sparse") || !accessor.find("bufferView") || !accessor.find("type"),
+      sparse or bufferless gltf accessors are not supported...
+      );
+
+  GltfAccessor result;
+  result.count = static_cast<uint32_t>(accessor.numberOr("count", 0));
+  result.componentType = static_cast<uint32_t>(accessor.numberOr("componentType", 0));
+  result.components = gltfComponentCount(accessor.find("type")->string);
+  const JsonValue* normalized = accessor.find("normalized");
+  result.normalized = normalized && normalized->boolean;
+
+  const JsonValue& view = json.find("bufferViews")->at(static_cast<size_t>(accessor.find("bufferView")->number));
+  IF_THROW(
+      view.numberOr("buffer", 0) != 0,
+      only the glb bin chunk is supported as gltf buffer...
+      );
+
+  uint32_t elementSize = gltfComponentSize(result.componentType) * result.components;
+  result.stride = static_cast<uint32_t>(view.numberOr("byteStride", elementSize));
+
+  size_t offset = static_cast<size_t>(view.numberOr("byteOffset", 0) + accessor.numberOr("byteOffset", 0));
+  size_t viewEnd = static_cast<size_t>(view.numberOr("byteOffset", 0) + view.numberOr("byteLength", 0));
+  IF_THROW(
+      result.count > 0 && (viewEnd > bin.size() || offset + static_cast<size_t>(result.count - 1) * result.stride + elementSize > viewEnd),
+      gltf accessor outside of its buffer...
+      );
+
+  result.data = bin.data() + offset;
+  return result;
+}
+
+static float readGltfComponent(const GltfAccessor& accessor, uint32_t element, uint32_t component) {
+  const uint8_t* p = accessor.data + static_cast<size_t>(element) * accessor.stride + component * gltfComponentSize(accessor.componentType);
+  switch (accessor.componentType) {
+    case 5126: { float v; memcpy(&v, p, 4); return v; }
+    case 5121: return accessor.normalized ? *p / 255.0f : *p;
+    case 5123: { uint16_t v; memcpy(&v, p, 2); return accessor.normalized ? v / 65535.0f : v; }
+    case 5120: { int8_t v; memcpy(&v, p, 1); return accessor.normalized ? std::max(v / 127.0f, -1.0f) : v; }
+    case 5122: { int16_t v; memcpy(&v, p, 2); return accessor.normalized ? std::max(v / 32767.0f, -1.0f) : v; }
+    case 5125: { uint32_t v; memcpy(&v, p, 4); return static_cast<float>(v); }
+  }
+  return 0.0f;
+}
+
+static uint32_t readGltfIndex(const GltfAccessor& accessor, uint32_t element) {
+  const uint8_t* p = accessor.data + static_cast<size_t>(element) * accessor.stride;
+  switch (accessor.componentType) {
+    case 5121: return *p;
+    case 5123: { uint16_t v; memcpy(&v, p, 2); return v; }
+    case 5125: { uint32_t v; memcpy(&v, p, 4); return v; }
+  }
+  throw std::runtime_error("gltf indices must be unsigned integers");
+}
+
+static MeshData importGltfPrimitive(const JsonValue& json, const JsonValue& primitive, const std::vector<uint8_t>& bin) {
+  const JsonValue* attributes = primitive.find("attributes");
+  const JsonValue* position = attributes ? attributes->find("POSITION") : nullptr;
+  IF_THROW(
+      !position,
+      gltf primitive without positions...
+      );
+
+  GltfAccessor positions = getGltfAccessor(json, static_cast<uint32_t>(position->number), bin);
+  IF_THROW(
+      positions.components != 3,
+      gltf positions must be vec3...
+      );
+
+  std::vector<glm::vec2> texCoords(positions.count, glm::vec2(0.0f));
+  if (const JsonValue* texCoord = attributes->find("TEXCOORD_0")) {
+    GltfAccessor accessor = getGltfAccessor(json, static_cast<uint32_t>(texCoord->number), bin);
+    IF_THROW(
+        accessor.components != 2,
+        gltf texture coordinates must be vec2...
+        );
+    for (uint32_t i = 0; i < std::min(accessor.count, positions.count); i++) {
+      texCoords[i] = glm::vec2(readGltfComponent(accessor, i, 0), readGltfComponent(accessor, i, 1));
+    }
+  }
+
+  std::vector<glm::vec3> colors(positions.count, glm::vec3(1.0f));
+  if (const JsonValue* color = attributes->find("COLOR_0")) {
+    GltfAccessor accessor = getGltfAccessor(json, static_cast<uint32_t>(color->number), bin);
+    // the alpha of vec4 colors is dropped
+    IF_THROW(
+        accessor.components != 3 && accessor.components != 4,
+        gltf colors must be vec3 or vec4...
+        );
+    for (uint32_t i = 0; i < std::min(accessor.count, positions.count); i++) {
+      colors[i] = glm::vec3(readGltfComponent(accessor, i, 0), readGltfComponent(accessor, i, 1), readGltfComponent(accessor, i, 2));
+    }
+  }
+
+  MeshData mesh;
+  mesh.vertices.reserve(positions.count);
+  for (uint32_t i = 0; i < positions.count; i++) {
+    glm::vec3 position(readGltfComponent(positions, i, 0), readGltfComponent(positions, i, 1), readGltfComponent(positions, i, 2));
+    mesh.vertices.push_back(Vertex::pack(position, colors[i], texCoords[i]));
+  }
+
+  std::vector<uint32_t> indices;
+  if (const JsonValue* index = primitive.find("indices")) {
+    GltfAccessor indexAccessor = getGltfAccessor(json, static_cast<uint32_t>(index->number), bin);
+    indices.resize(indexAccessor.count);
+    for (uint32_t i = 0; i < indexAccessor.count; i++) {
+      indices[i] = readGltfIndex(indexAccessor, i);
+      IF_THROW(
+          indices[i] >= positions.count,
+          gltf index out of range...
+          );
+    }
+  } else {
+    indices.resize(positions.count);
+    for (uint32_t i = 0; i < positions.count; i++) indices[i] = i;
+  }
+
+  myUtils::packIndices(indices, positions.count, &mesh);
+  return mesh;
+}
+
+static std::vector<MeshData> importGlb(const std::vector<char>& file) {
+  const uint32_t glbMagic = 0x46546C67;  // "glTF"
+  const uint32_t jsonChunk = 0x4E4F534A; // "JSON"
+  const uint32_t binChunk = 0x004E4942;  // "BIN\0"
+
+  uint32_t header[3];
+  IF_THROW(
+      file.size() < sizeof(header) + 8,
+      glb file too small...
+      );
+  memcpy(header, file.data(), sizeof(header));
+  IF_THROW(
+      header[0] != glbMagic || header[1] != 2,
+      not a glTF 2.0 binary file...
+      );
+
+  JsonValue json;
+  std::vector<uint8_t> bin;
+  bool hasJson = false;
+
+  size_t offset = sizeof(header);
+  while (offset + 8 <= file.size()) {
+    uint32_t chunk[2];
+    memcpy(chunk, file.data() + offset, sizeof(chunk));
+    offset += sizeof(chunk);
+    IF_THROW(
+        chunk[0] > file.size() - offset,
+        glb chunk outside of the file...
+        );
+
+    const char* data = file.data() + offset;
+    if (chunk[1] == jsonChunk && !hasJson) {
+      json = JsonParser(data, data + chunk[0]).parse();
+      hasJson = true;
+    } else if (chunk[1] == binChunk && bin.empty()) {
+      bin.assign(data, data + chunk[0]);
+    }
+    offset += chunk[0];
+  }
+
+  IF_THROW(
+      !hasJson || !json.find("meshes") || !json.find("accessors") || !json.find("bufferViews"),
+      glb without meshes...
+      );
+
+  std::vector<MeshData> meshes;
+  for (const auto& mesh : json.find("meshes")->values) {
+    const JsonValue* primitives = mesh.find("primitives");
+    if (!primitives) continue;
+    for (const auto& primitive : primitives->values) {
+      // only triangle lists, 4 is the default mode
+      if (primitive.numberOr("mode", 4) != 4) continue;
+      meshes.push_back(importGltfPrimitive(json, primitive, bin));
+    }
+  }
+
+  IF_THROW(
+      meshes.empty(),
+      glb has no triangle primitives...
+      );
+
+  return meshes;
+}
+
+namespace myUtils {
+
+  std::vector<MeshData> importMesh(const std::string& filename) {
+    std::vector<char> file = readBinaryFile(filename);
+
+    std::vector<MeshData> meshes;
+    if (hasExtension(filename, ".obj")) {
+      meshes = importObj(file);
+    } else if (hasExtension(filename, ".glb")) {
+      meshes = importGlb(file);
+    } else {
+      throw std::runtime_error("unsupported mesh format: " + filename);
+    }
+
+    for (auto& mesh : meshes) {
+      computeBounds(&mesh);
+    }
+    return meshes;
+  }
+
+  void packIndices(const std::vector<uint32_t>& indices, uint32_t vertexCount, MeshData* mesh) {
+    mesh->indexCount = static_cast<uint32_t>(indices.size());
+
+    if (vertexCount <= 65536) {
+      mesh->indexType = vk::IndexType::eUint16;
+      mesh->indices.resize(indices.size() * sizeof(uint16_t));
+      uint16_t* out = reinterpret_cast<uint16_t*>(mesh->indices.data());
+      for (size_t i = 0; i < indices.size(); i++) {
+        out[i] = static_cast<uint16_t>(indices[i]);
+      }
+    } else {
+      mesh->indexType = vk::IndexType::eUint32;
+      mesh->indices.resize(indices.size() * sizeof(uint32_t));
+      memcpy(mesh->indices.data(), indices.data(), mesh->indices.size());
+    }
+  }
+
+  void computeBounds(MeshData* mesh) {
+    if (mesh->vertices.empty()) return;
+
+    glm::vec3 lower(std::numeric_limits<float>::max());
+    glm::vec3 upper(std::numeric_limits<float>::lowest());
+    for (const auto& vertex : mesh->vertices) {
+      glm::vec3 position = glm::vec3(glm::unpackHalf4x16(vertex.pos));
+      lower = glm::min(lower, position);
+      upper = glm::max(upper, position);
+    }
+
+    glm::vec3 center = (lower + upper) * 0.5f;
+    float radius = 0.0f;
+    for (const auto& vertex : mesh->vertices) {
+      radius = std::max(radius, glm::length(glm::vec3(glm::unpackHalf4x16(vertex.pos)) - center));
+    }
+    mesh->bounds = glm::vec4(center, radius);
+  }
+
+};
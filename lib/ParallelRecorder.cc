@@ -0,0 +1,111 @@
+#include "ParallelRecorder.hh"
+
+#include <algorithm>
+#include <future>
+
+#include "ThreadPool.hh"
+#include "Macros.hh"
+
+void ParallelRecorder::init(vk::Device device, uint32_t queueFamily, ThreadPool* threadPool, uint32_t framesInFlight) {
+  _device = device;
+  _threadPool = threadPool;
+
+  // transient, the buffers are rerecorded every frame and only ever reset with their pool
+  vk::CommandPoolCreateInfo createInfo;
+  createInfo.setFlags(vk::CommandPoolCreateFlagBits::eTransient)
+            .setQueueFamilyIndex(queueFamily);
+
+  _pools.resize(framesInFlight);
+  for (auto& framePools : _pools) {
+    framePools.resize(std::max(_threadPool->getThreadCount(), 1u));
+    for (auto& chunkPool : framePools) {
+      chunkPool.pool = _device.createCommandPool(createInfo);
+      CHECK_NULL(chunkPool.pool);
+    }
+  }
+}
+
+void ParallelRecorder::cleanup() {
+  for (auto& framePools : _pools) {
+    for (auto& chunkPool : framePools) {
+      _device.destroyCommandPool(chunkPool.pool);
+    }
+  }
+  _pools.clear();
+}
+
+void ParallelRecorder::beginFrame(uint32_t frame) {
+  _currentFrame = frame;
+  for (auto& chunkPool : _pools[frame]) {
+    if (chunkPool.next == 0) continue;
+    _device.resetCommandPool(chunkPool.pool);
+    chunkPool.next = 0;
+  }
+}
+
+std::vector<vk::CommandBuffer> ParallelRecorder::record(
+    uint32_t count,
+    const vk::CommandBufferInheritanceInfo& inheritance,
+    const std::function<void(vk::CommandBuffer, uint32_t, uint32_t)>& recordChunk) {
+  std::vector<ChunkPool>& framePools = _pools[_currentFrame];
+  uint32_t chunkCount = std::min(count, static_cast<uint32_t>(framePools.size()));
+  if (chunkCount == 0) {
+    return {};
+  }
+
+  // buffers are taken here on the calling thread, the workers only record into them
+  std::vector<vk::CommandBuffer> buffers(chunkCount);
+  for (uint32_t chunk = 0; chunk < chunkCount; chunk++) {
+    buffers[chunk] = nextBuffer(&framePools[chunk]);
+  }
+
+  std::vector<std::future<void>> jobs;
+  jobs.reserve(chunkCount);
+  for (uint32_t chunk = 0; chunk < chunkCount; chunk++) {
+    // the first count % chunkCount chunks take one more
+    uint32_t begin = chunk * (count / chunkCount) + std::min(chunk, count % chunkCount);
+    uint32_t end = begin + count / chunkCount + (chunk < count % chunkCount ? 1 : 0);
+    vk::CommandBuffer buffer = buffers[chunk];
+
+    jobs.push_back(_threadPool->submit([buffer, begin, end, &inheritance, &recordChunk]() {
+      vk::CommandBufferBeginInfo beginInfo;
+      beginInfo.setFlags(vk::CommandBufferUsageFlagBits::eRenderPassContinue | vk::CommandBufferUsageFlagBits::eOneTimeSubmit)
+               .setPInheritanceInfo(&inheritance);
+
+      buffer.begin(beginInfo);
+      recordChunk(buffer, begin, end);
+      buffer.end();
+    }));
+  }
+
+  // every job is waited on before rethrowing, the lambdas refer to this frame
+  std::exception_ptr error;
+  for (auto& job : jobs) {
+    try {
+      job.get();
+    } catch (...) {
+      if (!error) error = std::current_exception();
+    }
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+
+  return buffers;
+}
+
+uint32_t ParallelRecorder::getChunkCount() const {
+  return _pools.empty() ? 0 : static_cast<uint32_t>(_pools[0].size());
+}
+
+vk::CommandBuffer ParallelRecorder::nextBuffer(ChunkPool* chunkPool) {
+  if (chunkPool->next == chunkPool->buffers.size()) {
+    vk::CommandBufferAllocateInfo allocInfo;
+    allocInfo.setCommandPool(chunkPool->pool)
+             .setLevel(vk::CommandBufferLevel::eSecondary)
+             .setCommandBufferCount(1);
+
+    chunkPool->buffers.push_back(_device.allocateCommandBuffers(allocInfo)[0]);
+  }
+  return chunkPool->buffers[chunkPool->next++];
+}
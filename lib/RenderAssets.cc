@@ -2,8 +2,12 @@
 
 #include <vulkan/vulkan.hpp>
 
+#include <algorithm>
+#include <cstring>
+
 #include "VulkanInstance.hh"
 #include "VkUtils.hh"
+#include "ShaderRegistry.hh"
 #include "Structs.hh"
 #include "Macros.hh"
 
@@ -12,37 +16,97 @@
     throw std::runtime_error(#message); \
   }
 
+// stored in front of the driver's cache data, lets a file from another gpu or driver be
+// thrown away before it reaches vkCreatePipelineCache
+struct PipelineCachePrefix {
+  uint32_t magic;
+  uint32_t dataSize;
+  uint32_t vendorID;
+  uint32_t deviceID;
+  uint32_t driverVersion;
+  uint8_t uuid[VK_UUID_SIZE];
+};
+
+const uint32_t pipelineCacheMagic = 0x43505652; // "RVPC"
+
 void RenderAssets::init(VulkanInstance* instance) {
   _instance = instance;
   _device = _instance->getLogicalDevice();
   _gpu = _instance->getGPU();
   _graphicsQueue = _instance->getGraphicsQueue();
   _commandPool = _instance->getCommandPool();
+  _framesInFlight = _instance->getFramesInFlight();
+
+  _allocator.init(_device, _gpu);
+  _stagingRing.init(_device, _gpu, STAGING_RING_SIZE);
+  _uploadBatch.init(
+      _device, 
+      _instance->getTransferQueue(), 
+      _instance->getTransferQueueFamily(), 
+      _instance->getGraphicsQueueFamily(), 
+      &_stagingRing
+      );
 
+  createPipelineCache();
   createDescriptorSetLayout();
+  createTextureSetLayout();
   createGraphicsPipeline();
-  createDescriptorPool();
+  createCullPipeline();
+  createDescriptorAllocator();
+  createTextureDescriptorSet();
   createTextureSampler();
 }
 
 void RenderAssets::cleanup() {
   _device.waitIdle();
-  cleanupImageViews();
+  _uploadBatch.cleanup();
+  _stagingRing.cleanup();
   cleanupBufferMemory();
   cleanupImageMemory();
+  _allocator.cleanup();
   cleanupSamplers();
-  cleanupDescriptorPool();
+  _descriptorAllocator.cleanup();
   cleanupDescriptorSetLayout();
   cleanupGraphicsPipeline();
   cleanupGraphicsPipelineLayout();
+  cleanupCullPipeline();
+  cleanupPipelineCache();
 }
 
-void RenderAssets::cleanupDescriptorPool() {
-  _device.destroyDescriptorPool(_descriptorPool);
+// must be called before init()
+void RenderAssets::setPipelineCachePath(const std::string& path) {
+  _pipelineCachePath = path;
+}
+
+// written back so the next start skips compiling the pipelines,
+// failing to write only costs that, so it is not an error
+void RenderAssets::cleanupPipelineCache() {
+  std::vector<uint8_t> data = _device.getPipelineCacheData(_pipelineCache);
+  vk::PhysicalDeviceProperties props = _gpu.getProperties();
+
+  PipelineCachePrefix prefix;
+  prefix.magic = pipelineCacheMagic;
+  prefix.dataSize = static_cast<uint32_t>(data.size());
+  prefix.vendorID = props.vendorID;
+  prefix.deviceID = props.deviceID;
+  prefix.driverVersion = props.driverVersion;
+  memcpy(prefix.uuid, props.pipelineCacheUUID.data(), VK_UUID_SIZE);
+
+  std::vector<char> file(sizeof(prefix) + data.size());
+  memcpy(file.data(), &prefix, sizeof(prefix));
+  memcpy(file.data() + sizeof(prefix), data.data(), data.size());
+
+  try {
+    myUtils::writeBinaryFile(_pipelineCachePath, file);
+  } catch (std::runtime_error& e) {
+  }
+
+  _device.destroyPipelineCache(_pipelineCache);
 }
 
 void RenderAssets::cleanupDescriptorSetLayout() {
   _device.destroyDescriptorSetLayout(_descriptorSetLayout);
+  _device.destroyDescriptorSetLayout(_textureSetLayout);
 }
 
 void RenderAssets::cleanupGraphicsPipelineLayout() {
@@ -53,34 +117,58 @@ void RenderAssets::cleanupGraphicsPipeline() {
   _device.destroyPipeline(_graphicsPipeline);
 }
 
+void RenderAssets::cleanupCullPipeline() {
+  _device.destroyPipeline(_cullPipeline);
+  _device.destroyPipelineLayout(_cullPipelineLayout);
+  _device.destroyDescriptorSetLayout(_cullDescriptorSetLayout);
+}
+
 void RenderAssets::cleanupBufferMemory() {
-  for (uint32_t i = 0; i < _bufferIndex; i++) {
-    _device.destroyBuffer(_buffers.at(i));
-    _device.freeMemory(_memories.at(i));
+  for (const auto& [frame, resource] : _retiredBuffers) {
+    releaseBuffer(resource);
   }
+  _retiredBuffers.clear();
+  _buffers.forEach([this](const BufferResource& resource) {
+    releaseBuffer(resource);
+  });
+  _buffers.clear();
 }
 
 void RenderAssets::cleanupImageMemory() {
-  for (uint32_t i = 0; i < _imageIndex; i++) {
-    _device.destroyImage(_images.at(i));
-    _device.freeMemory(_imageMemories.at(i));
+  for (const auto& [frame, resource] : _retiredImages) {
+    releaseImage(resource);
   }
+  _retiredImages.clear();
+  _images.forEach([this](const ImageResource& resource) {
+    releaseImage(resource);
+  });
+  _images.clear();
 }
 
-void RenderAssets::cleanupImageViews() {
-  for (uint32_t i = 0; i < _imageIndex; i++) {
-    try {
-      _device.destroyImageView(_imageViews.at(i));
-    } catch (std::out_of_range& e) {
-      continue;
-    }
+void RenderAssets::releaseBuffer(const BufferResource& resource) {
+  _descriptorAllocator.evict(resource.buffer);
+  _device.destroyBuffer(resource.buffer);
+  _allocator.free(resource.memory);
+}
+
+void RenderAssets::releaseImage(const ImageResource& resource) {
+  if (resource.view) {
+    _descriptorAllocator.evict(resource.view);
+    _device.destroyImageView(resource.view);
   }
+  _device.destroyImage(resource.image);
+  _allocator.free(resource.memory);
 }
 
 void RenderAssets::cleanupSamplers() {
   _device.destroySampler(_textureSampler);
 }
 
+// every pipeline created by the project should go through this cache
+vk::PipelineCache RenderAssets::getPipelineCache() const {
+  return _pipelineCache;
+}
+
 vk::Pipeline RenderAssets::getGraphicsPipeline() const {
   return _graphicsPipeline;
 }
@@ -89,10 +177,6 @@ vk::PipelineLayout RenderAssets::getGraphicsPipelineLayout() const {
   return _graphicsPipelineLayout;
 }
 
-vk::DescriptorPool RenderAssets::getDescriptorPool() const {
-  return _descriptorPool;
-}
-
 vk::DescriptorSetLayout RenderAssets::getDescriptorSetLayout() const {
   return _descriptorSetLayout;
 }
@@ -101,17 +185,80 @@ const vk::DescriptorSet* RenderAssets::getDescriptorSet() const {
   return _descriptorSets.data();
 }
 
-vk::Buffer RenderAssets::getBuffer(uint32_t index) const {
-  return _buffers.at(index);
+vk::DescriptorSet RenderAssets::getTextureDescriptorSet() const {
+  return _textureDescriptorSet;
+}
+
+vk::Pipeline RenderAssets::getCullPipeline() const {
+  return _cullPipeline;
+}
+
+vk::PipelineLayout RenderAssets::getCullPipelineLayout() const {
+  return _cullPipelineLayout;
+}
+
+const vk::DescriptorSet* RenderAssets::getCullDescriptorSet() const {
+  return _cullDescriptorSets.data();
+}
+
+vk::Buffer RenderAssets::getBuffer(BufferHandle handle) const {
+  return _buffers.at(handle).buffer;
+}
+
+vk::Image RenderAssets::getImage(ImageHandle handle) const {
+  return _images.at(handle).image;
+}
+
+vk::ImageView RenderAssets::getImageView(ImageHandle handle) const {
+  return _images.at(handle).view;
 }
 
-vk::Image RenderAssets::getImage(uint32_t index) const {
-  return _images.at(index);
+vk::Sampler RenderAssets::getTextureSampler() const {
+  return _textureSampler;
 }
 
-uint32_t RenderAssets::createImage(
+MemoryStats RenderAssets::getMemoryStats() const {
+  return _allocator.getStats();
+}
+
+// generateMipmaps() blits with linear filtering, other formats need their levels built on the cpu
+bool RenderAssets::supportsMipmapBlit(vk::Format format) const {
+  vk::FormatFeatureFlags features = _gpu.getFormatProperties(format).optimalTilingFeatures;
+  vk::FormatFeatureFlags required = 
+    vk::FormatFeatureFlagBits::eBlitSrc | 
+    vk::FormatFeatureFlagBits::eBlitDst | 
+    vk::FormatFeatureFlagBits::eSampledImageFilterLinear;
+  return (features & required) == required;
+}
+
+// every format TextureImport may pick when block compression is allowed
+bool RenderAssets::supportsBlockCompression() const {
+  if (!_instance->getEnabledFeatures().textureCompressionBC) return false;
+
+  vk::FormatFeatureFlags required = 
+    vk::FormatFeatureFlagBits::eSampledImage | 
+    vk::FormatFeatureFlagBits::eSampledImageFilterLinear;
+  for (vk::Format format : { vk::Format::eBc1RgbSrgbBlock, vk::Format::eBc3SrgbBlock, vk::Format::eBc4UnormBlock, vk::Format::eBc5UnormBlock }) {
+    if ((_gpu.getFormatProperties(format).optimalTilingFeatures & required) != required) return false;
+  }
+  return true;
+}
+
+// the one and two channel srgb formats are optional, TextureImport falls back to linear unorm
+bool RenderAssets::supportsSrgbGrey() const {
+  vk::FormatFeatureFlags required = 
+    vk::FormatFeatureFlagBits::eSampledImage | 
+    vk::FormatFeatureFlagBits::eSampledImageFilterLinear;
+  for (vk::Format format : { vk::Format::eR8Srgb, vk::Format::eR8G8Srgb }) {
+    if ((_gpu.getFormatProperties(format).optimalTilingFeatures & required) != required) return false;
+  }
+  return true;
+}
+
+ImageHandle RenderAssets::createImage(
     uint32_t width, 
     uint32_t height, 
+    uint32_t mipLevels, 
     vk::Format format, 
     vk::ImageTiling tiling, 
     vk::ImageUsageFlags usage, 
@@ -122,7 +269,7 @@ uint32_t RenderAssets::createImage(
                   {width, height}, 
                   1
                   ))
-            .setMipLevels(1)
+            .setMipLevels(mipLevels)
             .setArrayLayers(1)
             .setFormat(format)
             .setTiling(tiling)
@@ -131,33 +278,30 @@ uint32_t RenderAssets::createImage(
             .setSamples(vk::SampleCountFlagBits::e1)
             .setSharingMode(vk::SharingMode::eExclusive);
 
-  _images[_imageIndex] = _device.createImage(createInfo);
-  CHECK_NULL(_images[_imageIndex]);
-
-  vk::MemoryRequirements memRequirements = _device.getImageMemoryRequirements(_images.at(_imageIndex));
+  ImageResource resource;
+  resource.format = format;
+  resource.extent = vk::Extent2D(width, height);
+  resource.mipLevels = mipLevels;
+  resource.image = _device.createImage(createInfo);
+  CHECK_NULL(resource.image);
 
-  vk::MemoryAllocateInfo allocInfo;
-  allocInfo.setAllocationSize(memRequirements.size)
-           .setMemoryTypeIndex(myUtils::findMemType(
-                 memRequirements.memoryTypeBits, 
-                 memoryProp, 
-                 _gpu
-                 ));
+  vk::MemoryRequirements memRequirements = _device.getImageMemoryRequirements(resource.image);
 
-  _imageMemories[_imageIndex] = _device.allocateMemory(allocInfo);
-  CHECK_NULL(_imageMemories[_imageIndex]);
+  resource.memory = _allocator.allocate(memRequirements, memoryProp, tiling == vk::ImageTiling::eLinear);
+  CHECK_NULL(resource.memory.memory);
 
-  _device.bindImageMemory(_images[_imageIndex], _imageMemories[_imageIndex], 0);
+  _device.bindImageMemory(resource.image, resource.memory.memory, resource.memory.offset);
 
-  return _imageIndex++;
+  return _images.insert(resource);
 }
 
-void RenderAssets::createImageView(uint32_t index) {
-  _imageViews[index] = myUtils::createImageView(_images.at(index), vk::Format::eR8G8B8A8Srgb, _device);
-  CHECK_NULL(_imageViews.at(index));
+void RenderAssets::createImageView(ImageHandle handle, vk::ComponentMapping components) {
+  ImageResource& resource = _images.at(handle);
+  resource.view = myUtils::createImageView(resource.image, resource.format, _device, resource.mipLevels, components);
+  CHECK_NULL(resource.view);
 }
 
-uint32_t RenderAssets::createBuffer(
+BufferHandle RenderAssets::createBuffer(
     vk::DeviceSize size, 
     vk:: BufferUsageFlags usage, 
     vk::MemoryPropertyFlags memoryProp) {
@@ -167,135 +311,302 @@ uint32_t RenderAssets::createBuffer(
             .setUsage(usage)
             .setSharingMode(vk::SharingMode::eExclusive);
 
-  _buffers[_bufferIndex] = _device.createBuffer(bufferInfo);
+  BufferResource resource;
+  resource.buffer = _device.createBuffer(bufferInfo);
 
-  vk::MemoryRequirements memRequirement = _device.getBufferMemoryRequirements(_buffers.at(_bufferIndex));
+  vk::MemoryRequirements memRequirement = _device.getBufferMemoryRequirements(resource.buffer);
 
-  vk::MemoryAllocateInfo memoryInfo;
-  memoryInfo.setAllocationSize(memRequirement.size)
-            .setMemoryTypeIndex(myUtils::findMemType(
-                  memRequirement.memoryTypeBits, 
-                  memoryProp, 
-                  _gpu));
+  resource.memory = _allocator.allocate(memRequirement, memoryProp, true);
 
-  _memories[_bufferIndex] = _device.allocateMemory(memoryInfo);
+  _device.bindBufferMemory(resource.buffer, resource.memory.memory, resource.memory.offset);
 
-  _device.bindBufferMemory(_buffers.at(_bufferIndex), _memories.at(_bufferIndex), 0);
+  return _buffers.insert(resource);
+}
+
+void RenderAssets::destroyBuffer(BufferHandle handle) {
+  _retiredBuffers.push_back({ _instance->getFrameCount(), _buffers.at(handle) });
+  _buffers.erase(handle);
+}
 
-  return _bufferIndex++;
+void RenderAssets::destroyImage(ImageHandle handle) {
+  _retiredImages.push_back({ _instance->getFrameCount(), _images.at(handle) });
+  _images.erase(handle);
 }
 
-void RenderAssets::mapMemory(uint32_t index, vk::DeviceSize size, void** mem) {
+// call after waitForFence(), a resource destroyed in frame n was last recorded in frame n
+// whose fence has been waited once framesInFlight more frames have started
+void RenderAssets::collectGarbage() {
+  uint64_t frameCount = _instance->getFrameCount();
+
+  auto buffersEnd = std::remove_if(_retiredBuffers.begin(), _retiredBuffers.end(), 
+      [this, frameCount](const std::pair<uint64_t, BufferResource>& retired) {
+        if (retired.first + _framesInFlight > frameCount) return false;
+        releaseBuffer(retired.second);
+        return true;
+      });
+  _retiredBuffers.erase(buffersEnd, _retiredBuffers.end());
+
+  auto imagesEnd = std::remove_if(_retiredImages.begin(), _retiredImages.end(), 
+      [this, frameCount](const std::pair<uint64_t, ImageResource>& retired) {
+        if (retired.first + _framesInFlight > frameCount) return false;
+        releaseImage(retired.second);
+        return true;
+      });
+  _retiredImages.erase(imagesEnd, _retiredImages.end());
+}
+
+// the allocator keeps host visible blocks persistently mapped, so this never unmaps
+void RenderAssets::mapMemory(BufferHandle handle, vk::DeviceSize size, void** mem) {
+  const MemoryAllocation& memory = _buffers.at(handle).memory;
   IF_THROW(
-      _device.mapMemory(_memories.at(index), 0, size, vk::MemoryMapFlags(0), mem) != vk::Result::eSuccess, 
-      trouble mapping memory
+      size > memory.size,
+      mapping past the end of the buffer memory
       );
+  *mem = _allocator.map(memory);
+}
+
+// the returned memory is already mapped, fill it and hand it to storeBuffer/storeBufferToImage
+StagingAllocation RenderAssets::allocateStaging(vk::DeviceSize size) {
+  return _stagingRing.allocate(size);
+}
+
+// textures are written one by one with writeTextureDescriptor
+// the slice is picked by the dynamic offset at bind time, so every frame in flight
+// ends up with the same cached set
+void RenderAssets::updateDescriptorSets(BufferHandle buffer) {
+  DescriptorBinding uniformBinding;
+  uniformBinding.binding = 0;
+  uniformBinding.type = vk::DescriptorType::eUniformBufferDynamic;
+  uniformBinding.buffer = _buffers.at(buffer).buffer;
+  uniformBinding.range = sizeof(UniformBufferObject);
+
+  _descriptorSets.assign(_framesInFlight, _descriptorAllocator.getOrCreate(_descriptorSetLayout, { uniformBinding }));
 }
 
-// added things for textureimage
-void RenderAssets::updateDescriptorSets(uint32_t bufferIndex, uint32_t imageIndex) {
-  std::vector<vk::DescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, _descriptorSetLayout);
-  vk::DescriptorSetAllocateInfo allocInfo;
-  allocInfo.setDescriptorPool(_descriptorPool)
-           .setSetLayouts(layouts)
-           .setDescriptorSetCount(static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT));
-
-  _descriptorSets.resize(MAX_FRAMES_IN_FLIGHT);
-  _descriptorSets = _device.allocateDescriptorSets(allocInfo);
-
-  for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-    vk::DescriptorBufferInfo bufferInfo;
-    bufferInfo.setBuffer(_buffers.at(bufferIndex))
-              .setOffset(0 + i * sizeof(UniformBufferObject))
-              .setRange(sizeof(UniformBufferObject));
-
-    vk::DescriptorImageInfo imageInfo;
-    imageInfo.setImageLayout(vk::ImageLayout::eShaderReadOnlyOptimal)
-             .setImageView(_imageViews.at(imageIndex))
-             .setSampler(_textureSampler);
-
-    std::vector<vk::WriteDescriptorSet> descriptorWrites;
-    descriptorWrites.resize(2);
-    descriptorWrites[0].setDstSet(_descriptorSets[i])
-                       .setDstBinding(0)
-                       .setDstArrayElement(0)
-                       .setDescriptorType(vk::DescriptorType::eUniformBuffer)
-                       .setDescriptorCount(1)
-                       .setBufferInfo(bufferInfo);
-    descriptorWrites[1].setDstSet(_descriptorSets[i])
-                       .setDstBinding(1)
-                       .setDstArrayElement(0)
-                       .setDescriptorType(vk::DescriptorType::eCombinedImageSampler)
-                       .setDescriptorCount(1)
-                       .setImageInfo(imageInfo);
-
-    _device.updateDescriptorSets(descriptorWrites.size(), descriptorWrites.data(), 0, nullptr);
+void RenderAssets::writeTextureDescriptor(uint32_t index, ImageHandle image) {
+  IF_THROW(
+      index >= MAX_BINDLESS_TEXTURES,
+      texture index out of the bindless array...
+      );
+
+  vk::DescriptorImageInfo imageInfo;
+  imageInfo.setImageLayout(vk::ImageLayout::eShaderReadOnlyOptimal)
+           .setImageView(_images.at(image).view)
+           .setSampler(_textureSampler);
+
+  vk::WriteDescriptorSet descriptorWrite;
+  descriptorWrite.setDstSet(_textureDescriptorSet)
+                 .setDstBinding(0)
+                 .setDstArrayElement(index)
+                 .setDescriptorType(vk::DescriptorType::eCombinedImageSampler)
+                 .setDescriptorCount(1)
+                 .setImageInfo(imageInfo);
+
+  _device.updateDescriptorSets(1, &descriptorWrite, 0, nullptr);
+}
+
+void RenderAssets::updateCullDescriptorSets(
+    BufferHandle uniformBuffer, 
+    BufferHandle instances, 
+    BufferHandle bounds, 
+    BufferHandle commands, 
+    BufferHandle visibleInstances) {
+  std::array<BufferHandle, 5> buffers = { uniformBuffer, instances, bounds, commands, visibleInstances };
+
+  std::vector<DescriptorBinding> bindings(buffers.size());
+  for (uint32_t binding = 0; binding < bindings.size(); binding++) {
+    bindings[binding].binding = binding;
+    bindings[binding].type = binding == 0 ? vk::DescriptorType::eUniformBufferDynamic : vk::DescriptorType::eStorageBuffer;
+    bindings[binding].buffer = _buffers.at(buffers[binding]).buffer;
   }
+  bindings[0].range = sizeof(UniformBufferObject);
+
+  _cullDescriptorSets.assign(_framesInFlight, _descriptorAllocator.getOrCreate(_cullDescriptorSetLayout, bindings));
 }
 
-void RenderAssets::storeBuffer(vk::Buffer src, uint32_t dst, vk::DeviceSize size) {
+void RenderAssets::storeBuffer(const StagingAllocation& src, BufferHandle dst, vk::DeviceSize size, vk::DeviceSize dstOffset) {
   vk::BufferCopy copyRegion{};
-  copyRegion.setDstOffset(0)
-            .setSrcOffset(0)
+  copyRegion.setDstOffset(dstOffset)
+            .setSrcOffset(src.offset)
             .setSize(size);
   
-  vk::CommandBuffer cmdBuffer = myUtils::beginSingleTimeCommands(_device, _instance->getCommandPool());
+  _uploadBatch.copyBuffer(src.buffer, _buffers.at(dst).buffer, copyRegion);
+}
 
-    cmdBuffer.copyBuffer(src, _buffers.at(dst), copyRegion);
+// copies in chunks of a quarter ring, the uploads are flushed between chunks so the ring
+// can recycle space while large meshes stream in, the last chunk is left to the caller's flush
+void RenderAssets::uploadBuffer(BufferHandle dst, const void* data, vk::DeviceSize size, vk::DeviceSize dstOffset) {
+  const vk::DeviceSize chunkSize = STAGING_RING_SIZE / 4;
+  const char* src = static_cast<const char*>(data);
 
-    myUtils::submitSingleTimeCommands(cmdBuffer, _instance->getGraphicsQueue(), _device, _instance->getCommandPool());
+  for (vk::DeviceSize offset = 0; offset < size; offset += chunkSize) {
+    if (offset > 0) {
+      flushUploads();
+    }
+    vk::DeviceSize copySize = std::min(chunkSize, size - offset);
+    StagingAllocation staging = allocateStaging(copySize);
+    memcpy(staging.data, src + offset, copySize);
+    storeBuffer(staging, dst, copySize, dstOffset + offset);
+  }
 }
 
-void RenderAssets::storeBufferToImage(vk::Buffer src, uint32_t dst, const uint32_t& width, const uint32_t& height) {
+void RenderAssets::storeBufferToImage(const StagingAllocation& src, ImageHandle dst, const uint32_t& width, const uint32_t& height, uint32_t mipLevel) {
   vk::BufferImageCopy region;
-  region.setBufferOffset(0)
+  region.setBufferOffset(src.offset)
         .setBufferRowLength(0)
         .setBufferImageHeight(0)
         .setImageSubresource(vk::ImageSubresourceLayers(
                  vk::ImageAspectFlagBits::eColor, 
-                 0, 0, 1
+                 mipLevel, 0, 1
                  ))
         .setImageOffset({0, 0, 0})
         .setImageExtent({width, height, 1});
-  vk::CommandBuffer commandBuffer = myUtils::beginSingleTimeCommands(_device, _instance->getCommandPool());
-    commandBuffer.copyBufferToImage(src, _images.at(dst), vk::ImageLayout::eTransferDstOptimal, 1, &region);
-    myUtils::submitSingleTimeCommands(commandBuffer, _instance->getGraphicsQueue(), _device, _instance->getCommandPool());
+  _uploadBatch.copyBufferToImage(src.buffer, _images.at(dst).image, region);
+}
+
+void RenderAssets::transitionImageLayout(
+    ImageHandle handle, 
+    vk::ImageLayout oldLayout, 
+    vk::ImageLayout newLayout, 
+    uint32_t baseMipLevel, 
+    uint32_t levelCount) {
+  _uploadBatch.transitionImageLayout(_images.at(handle).image, oldLayout, newLayout, baseMipLevel, levelCount);
+}
+
+// fills every level below 0 from level 0, all levels must be in TransferDstOptimal,
+// they end up in ShaderReadOnlyOptimal
+void RenderAssets::generateMipmaps(ImageHandle handle) {
+  const ImageResource& resource = _images.at(handle);
+  _uploadBatch.generateMipmaps(resource.image, resource.extent.width, resource.extent.height, resource.mipLevels);
+}
+
+// storeBuffer/storeBufferToImage/transitionImageLayout only record,
+// nothing reaches the gpu before the uploads are flushed
+uint64_t RenderAssets::flushUploads() {
+  return _uploadBatch.submit();
+}
+
+// call once per frame before the render pass, uploads that finished on the transfer queue
+// are handed over to the graphics queue in this command buffer
+void RenderAssets::acquireUploads(vk::CommandBuffer commandBuffer) {
+  _uploadBatch.acquire(commandBuffer);
+}
+
+bool RenderAssets::isUploadComplete(uint64_t ticket) {
+  return _uploadBatch.isComplete(ticket);
+}
+
+// true once commands recorded after acquireUploads() may read the uploaded resources
+bool RenderAssets::isUploadReady(uint64_t ticket) const {
+  return _uploadBatch.isReady(ticket);
+}
+
+void RenderAssets::waitUploads(uint64_t ticket) {
+  _uploadBatch.wait(ticket);
+}
+
+// empty when there is no cache file or it was written by another gpu/driver
+std::vector<char> RenderAssets::loadPipelineCacheData() {
+  std::vector<char> file;
+  try {
+    file = myUtils::readBinaryFile(_pipelineCachePath);
+  } catch (std::runtime_error& e) {
+    return {};
+  }
+
+  PipelineCachePrefix prefix;
+  if (file.size() < sizeof(prefix)) return {};
+  memcpy(&prefix, file.data(), sizeof(prefix));
+
+  vk::PhysicalDeviceProperties props = _gpu.getProperties();
+
+  if (prefix.magic != pipelineCacheMagic
+      || prefix.dataSize != file.size() - sizeof(prefix)
+      || prefix.vendorID != props.vendorID
+      || prefix.deviceID != props.deviceID
+      || prefix.driverVersion != props.driverVersion
+      || memcmp(prefix.uuid, props.pipelineCacheUUID.data(), VK_UUID_SIZE) != 0) {
+    return {};
+  }
+
+  // the driver's own header (VkPipelineCacheHeaderVersionOne) has to agree as well
+  const char* data = file.data() + sizeof(prefix);
+  uint32_t header[4];
+  if (prefix.dataSize < sizeof(header) + VK_UUID_SIZE) return {};
+  memcpy(header, data, sizeof(header));
+
+  if (header[0] < sizeof(header) + VK_UUID_SIZE
+      || header[1] != static_cast<uint32_t>(vk::PipelineCacheHeaderVersion::eOne)
+      || header[2] != props.vendorID
+      || header[3] != props.deviceID
+      || memcmp(data + sizeof(header), props.pipelineCacheUUID.data(), VK_UUID_SIZE) != 0) {
+    return {};
+  }
+
+  return std::vector<char>(data, data + prefix.dataSize);
+}
+
+void RenderAssets::createPipelineCache() {
+  std::vector<char> data = loadPipelineCacheData();
+
+  vk::PipelineCacheCreateInfo createInfo;
+  createInfo.setInitialDataSize(data.size())
+            .setPInitialData(data.empty() ? nullptr : data.data());
+
+  _pipelineCache = _device.createPipelineCache(createInfo);
+  CHECK_NULL(_pipelineCache);
 }
 
 void RenderAssets::createDescriptorSetLayout() {
   vk::DescriptorSetLayoutBinding uboDescLayoutBinding;
   uboDescLayoutBinding.setBinding(0)
                       .setStageFlags(vk::ShaderStageFlagBits::eVertex)
-                      .setDescriptorType(vk::DescriptorType::eUniformBuffer)
+                      .setDescriptorType(vk::DescriptorType::eUniformBufferDynamic)
                       .setDescriptorCount(1);
 
+  vk::DescriptorSetLayoutCreateInfo createInfo{};
+  createInfo.setBindings(uboDescLayoutBinding);
+
+  _descriptorSetLayout = _device.createDescriptorSetLayout(createInfo);
+}
+
+// one partially bound array of every texture, indexed in the shader, so switching
+// textures costs no descriptor binds
+// update after bind layouts can't hold dynamic uniform buffers, hence a set of its own
+void RenderAssets::createTextureSetLayout() {
   vk::DescriptorSetLayoutBinding samplerDescLayoutBinding;
-  samplerDescLayoutBinding.setBinding(1)
+  samplerDescLayoutBinding.setBinding(0)
                           .setStageFlags(vk::ShaderStageFlagBits::eFragment)
                           .setDescriptorType(vk::DescriptorType::eCombinedImageSampler)
                           .setImmutableSamplers(nullptr) // this function has a side-effect that will make DescriptorCount be set to 0
                                                          // so it must be called before setting DescriptorCount
                                                          // how strange!
-                          .setDescriptorCount(1);
+                          .setDescriptorCount(MAX_BINDLESS_TEXTURES);
 
-  std::array<vk::DescriptorSetLayoutBinding, 2> bindings = {
-    uboDescLayoutBinding, 
-    samplerDescLayoutBinding
-  };
+  // update unused while pending lets new textures be written while frames in flight still use the set
+  vk::DescriptorBindingFlags bindingFlags = 
+    vk::DescriptorBindingFlagBits::ePartiallyBound | 
+    vk::DescriptorBindingFlagBits::eUpdateAfterBind |
+    vk::DescriptorBindingFlagBits::eUpdateUnusedWhilePending;
 
-  vk::DescriptorSetLayoutCreateInfo createInfo{};
-  createInfo.setBindingCount(bindings.size())
-            .setPBindings(bindings.data());
+  vk::DescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo;
+  bindingFlagsInfo.setBindingFlags(bindingFlags);
 
-  _descriptorSetLayout = _device.createDescriptorSetLayout(createInfo);
+  vk::DescriptorSetLayoutCreateInfo createInfo;
+  createInfo.setPNext(&bindingFlagsInfo)
+            .setFlags(vk::DescriptorSetLayoutCreateFlagBits::eUpdateAfterBindPool)
+            .setBindings(samplerDescLayoutBinding);
+
+  _textureSetLayout = _device.createDescriptorSetLayout(createInfo);
+  CHECK_NULL(_textureSetLayout);
 }
 
 void RenderAssets::createGraphicsPipeline() {
-  auto vertShaderCode = myUtils::readBinaryFile("../glslShaders/build/vert.spv");
-  auto fragShaderCode = myUtils::readBinaryFile("../glslShaders/build/frag.spv");
+  const EmbeddedShader& vertShader = myUtils::getEmbeddedShader("shader.vert");
+  const EmbeddedShader& fragShader = myUtils::getEmbeddedShader("shader.frag");
 
-  vk::ShaderModule vertShaderModule = myUtils::createShaderModule(_device, vertShaderCode);
-  vk::ShaderModule fragShaderModule = myUtils::createShaderModule(_device, fragShaderCode);
+  vk::ShaderModule vertShaderModule = myUtils::createShaderModule(_device, vertShader.code, vertShader.wordCount);
+  vk::ShaderModule fragShaderModule = myUtils::createShaderModule(_device, fragShader.code, fragShader.wordCount);
 
   vk::PipelineShaderStageCreateInfo vertShaderStageInfo;
   vertShaderStageInfo.setStage(vk::ShaderStageFlagBits::eVertex);
@@ -310,8 +621,15 @@ void RenderAssets::createGraphicsPipeline() {
   vk::PipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };
 
   vk::PipelineVertexInputStateCreateInfo vertexInputInfo;
-  const auto bindingDesc = Vertex::getBindingDescription();
-  const auto attribDesc = Vertex::getAttributeDescriptions();
+  // binding 0 per vertex, binding 1 per instance, instance attributes follow the vertex ones
+  std::vector<vk::VertexInputBindingDescription> bindingDesc = {
+    Vertex::Layout::getBindingDescription(0),
+    InstanceData::Layout::getBindingDescription(1, vk::VertexInputRate::eInstance),
+  };
+  const auto vertexAttribDesc = Vertex::Layout::getAttributeDescriptions(0);
+  const auto instanceAttribDesc = InstanceData::Layout::getAttributeDescriptions(1, Vertex::Layout::attributeCount);
+  std::vector<vk::VertexInputAttributeDescription> attribDesc(vertexAttribDesc.begin(), vertexAttribDesc.end());
+  attribDesc.insert(attribDesc.end(), instanceAttribDesc.begin(), instanceAttribDesc.end());
   vertexInputInfo.setVertexBindingDescriptions(bindingDesc)
                  .setVertexAttributeDescriptions(attribDesc);
 
@@ -371,8 +689,16 @@ void RenderAssets::createGraphicsPipeline() {
   colorBlending.setLogicOpEnable(VK_FALSE);
   colorBlending.setAttachments(colorBlendAttachment);
 
+  vk::PushConstantRange pushConstantRange;
+  pushConstantRange.setStageFlags(vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment)
+                   .setOffset(0)
+                   .setSize(sizeof(DrawPushConstants));
+
+  std::array<vk::DescriptorSetLayout, 2> setLayouts = { _descriptorSetLayout, _textureSetLayout };
+
   vk::PipelineLayoutCreateInfo pipelineLayoutInfo;
-  pipelineLayoutInfo.setSetLayouts(_descriptorSetLayout);
+  pipelineLayoutInfo.setSetLayouts(setLayouts)
+                    .setPushConstantRanges(pushConstantRange);
 
   _graphicsPipelineLayout = _device.createPipelineLayout(pipelineLayoutInfo);
   CHECK_NULL(_graphicsPipelineLayout);
@@ -394,7 +720,7 @@ void RenderAssets::createGraphicsPipeline() {
 
   vk::Result result;
 
-  std::tie(result, _graphicsPipeline) = _device.createGraphicsPipeline(nullptr, pipelineInfo);
+  std::tie(result, _graphicsPipeline) = _device.createGraphicsPipeline(_pipelineCache, pipelineInfo);
 
   IF_THROW(
       result != vk::Result::eSuccess,
@@ -405,20 +731,78 @@ void RenderAssets::createGraphicsPipeline() {
   _device.destroyShaderModule(vertShaderModule);
 }
 
-void RenderAssets::createDescriptorPool() {
-  std::vector<vk::DescriptorPoolSize> poolSizes;
-  poolSizes.resize(2);
-  poolSizes[0].setType(vk::DescriptorType::eUniformBuffer)
-              .setDescriptorCount(static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT));
+void RenderAssets::createCullPipeline() {
+  std::array<vk::DescriptorSetLayoutBinding, 5> bindings;
+  for (uint32_t binding = 0; binding < bindings.size(); binding++) {
+    bindings[binding].setBinding(binding)
+                     .setStageFlags(vk::ShaderStageFlagBits::eCompute)
+                     .setDescriptorType(binding == 0 ? vk::DescriptorType::eUniformBufferDynamic : vk::DescriptorType::eStorageBuffer)
+                     .setDescriptorCount(1);
+  }
+
+  vk::DescriptorSetLayoutCreateInfo layoutInfo;
+  layoutInfo.setBindings(bindings);
+
+  _cullDescriptorSetLayout = _device.createDescriptorSetLayout(layoutInfo);
+  CHECK_NULL(_cullDescriptorSetLayout);
+
+  vk::PushConstantRange pushConstantRange;
+  pushConstantRange.setStageFlags(vk::ShaderStageFlagBits::eCompute)
+                   .setOffset(0)
+                   .setSize(sizeof(CullPushConstants));
 
-  poolSizes[1].setType(vk::DescriptorType::eCombinedImageSampler)
-              .setDescriptorCount(static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT));
+  vk::PipelineLayoutCreateInfo pipelineLayoutInfo;
+  pipelineLayoutInfo.setSetLayouts(_cullDescriptorSetLayout)
+                    .setPushConstantRanges(pushConstantRange);
+
+  _cullPipelineLayout = _device.createPipelineLayout(pipelineLayoutInfo);
+  CHECK_NULL(_cullPipelineLayout);
+
+  const EmbeddedShader& compShader = myUtils::getEmbeddedShader("cull.comp");
+  vk::ShaderModule compShaderModule = myUtils::createShaderModule(_device, compShader.code, compShader.wordCount);
+
+  vk::PipelineShaderStageCreateInfo compShaderStageInfo;
+  compShaderStageInfo.setStage(vk::ShaderStageFlagBits::eCompute);
+  compShaderStageInfo.setModule(compShaderModule);
+  compShaderStageInfo.setPName("main");
+
+  vk::ComputePipelineCreateInfo pipelineInfo;
+  pipelineInfo.setStage(compShaderStageInfo)
+              .setLayout(_cullPipelineLayout);
+
+  vk::Result result;
+
+  std::tie(result, _cullPipeline) = _device.createComputePipeline(_pipelineCache, pipelineInfo);
 
-  vk::DescriptorPoolCreateInfo createInfo;
-  createInfo.setPoolSizes(poolSizes)
-            .setMaxSets(static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT));
+  IF_THROW(
+      result != vk::Result::eSuccess,
+      failed to create cullPipeline...
+      );
+
+  _device.destroyShaderModule(compShaderModule);
+}
+
+// pools are sized per set of each layout and grow as more sets are needed
+// graphics and cull sets for every frame in flight
+void RenderAssets::createDescriptorAllocator() {
+  _descriptorAllocator.init(_device);
+
+  _descriptorAllocator.registerLayout(_descriptorSetLayout, {
+    vk::DescriptorPoolSize(vk::DescriptorType::eUniformBufferDynamic, 1),
+  });
+  _descriptorAllocator.registerLayout(_cullDescriptorSetLayout, {
+    vk::DescriptorPoolSize(vk::DescriptorType::eUniformBufferDynamic, 1),
+    vk::DescriptorPoolSize(vk::DescriptorType::eStorageBuffer, 4),
+  });
+  // update after bind sets need a pool created with the matching flag
+  _descriptorAllocator.registerLayout(_textureSetLayout, {
+    vk::DescriptorPoolSize(vk::DescriptorType::eCombinedImageSampler, MAX_BINDLESS_TEXTURES),
+  }, 1, vk::DescriptorPoolCreateFlagBits::eUpdateAfterBind);
+}
 
-  _descriptorPool = _device.createDescriptorPool(createInfo);
+// allocated once, textures are written into it as they finish uploading
+void RenderAssets::createTextureDescriptorSet() {
+  _textureDescriptorSet = _descriptorAllocator.allocate(_textureSetLayout);
 }
 
 void RenderAssets::createTextureSampler() {
@@ -439,7 +823,7 @@ void RenderAssets::createTextureSampler() {
             .setMipmapMode(vk::SamplerMipmapMode::eLinear)
             .setMipLodBias(0.0f)
             .setMinLod(0.0f)
-            .setMaxLod(0.0f);
+            .setMaxLod(VK_LOD_CLAMP_NONE);
 
   _textureSampler = _device.createSampler(createInfo);
 }
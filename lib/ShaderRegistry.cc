@@ -0,0 +1,19 @@
+#include "ShaderRegistry.hh"
+
+#include <stdexcept>
+
+// generated into the build directory from the compiled shaders
+#include "EmbeddedShaders.inc"
+
+namespace myUtils {
+
+  const EmbeddedShader& getEmbeddedShader(const std::string& name) {
+    for (const auto& shader : embeddedShaders) {
+      if (name == shader.name) {
+        return shader;
+      }
+    }
+    throw std::runtime_error("no embedded shader named " + name);
+  }
+
+};
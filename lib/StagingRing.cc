@@ -0,0 +1,145 @@
+#include "StagingRing.hh"
+
+#include "VkUtils.hh"
+#include "Macros.hh"
+
+void StagingRing::init(vk::Device device, vk::PhysicalDevice gpu, vk::DeviceSize capacity) {
+  _device = device;
+  _capacity = capacity;
+
+  vk::BufferCreateInfo bufferInfo;
+  bufferInfo.setSize(_capacity)
+            .setUsage(vk::BufferUsageFlagBits::eTransferSrc)
+            .setSharingMode(vk::SharingMode::eExclusive);
+
+  _buffer = _device.createBuffer(bufferInfo);
+  CHECK_NULL(_buffer);
+
+  vk::MemoryRequirements memRequirement = _device.getBufferMemoryRequirements(_buffer);
+
+  vk::MemoryAllocateInfo memoryInfo;
+  memoryInfo.setAllocationSize(memRequirement.size)
+            .setMemoryTypeIndex(myUtils::findMemType(
+                  memRequirement.memoryTypeBits, 
+                  vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, 
+                  gpu));
+
+  _memory = _device.allocateMemory(memoryInfo);
+  CHECK_NULL(_memory);
+
+  _device.bindBufferMemory(_buffer, _memory, 0);
+
+  void* data;
+  IF_THROW(
+      _device.mapMemory(_memory, 0, _capacity, vk::MemoryMapFlags(0), &data) != vk::Result::eSuccess,
+      failed to map staging ring
+      );
+  _mapped = static_cast<char*>(data);
+}
+
+void StagingRing::cleanup() {
+  while (!_regions.empty()) {
+    reclaimRegion();
+  }
+  for (auto& fence : _freeFences) {
+    _device.destroyFence(fence);
+  }
+  _freeFences.clear();
+
+  _device.unmapMemory(_memory);
+  _device.destroyBuffer(_buffer);
+  _device.freeMemory(_memory);
+}
+
+StagingAllocation StagingRing::allocate(vk::DeviceSize size, vk::DeviceSize alignment) {
+  IF_THROW(
+      size > _capacity,
+      staging upload larger than the staging ring
+      );
+
+  while (true) {
+    bool empty = _regions.empty() && !_openUsed;
+    if (empty) {
+      _head = 0;
+      _openBegin = 0;
+    }
+
+    vk::DeviceSize tail = _regions.empty() ? _openBegin : _regions.front().begin;
+    vk::DeviceSize offset = (_head + alignment - 1) / alignment * alignment;
+    bool fits = false;
+
+    if (empty || _head > tail) {
+      if (offset + size <= _capacity) {
+        fits = true;
+      } else if (size <= tail) {
+        // wrap, the skipped bytes at the end go back with the region
+        offset = 0;
+        fits = true;
+      }
+    } else if (_head < tail) {
+      fits = offset + size <= tail;
+    }
+
+    if (fits) {
+      _head = offset + size;
+      _openUsed = true;
+      return { _buffer, offset, _mapped + offset };
+    }
+
+    IF_THROW(
+        _regions.empty(),
+        staging ring filled by uploads that were never submitted
+        );
+    reclaimRegion();
+  }
+}
+
+std::tuple<vk::Fence, uint64_t> StagingRing::closeRegion() {
+  vk::Fence fence;
+  if (_freeFences.empty()) {
+    fence = _device.createFence(vk::FenceCreateInfo());
+  } else {
+    fence = _freeFences.back();
+    _freeFences.pop_back();
+  }
+
+  Region region;
+  region.begin = _openBegin;
+  region.end = _head;
+  region.fence = fence;
+  region.serial = ++_serial;
+  _regions.push_back(region);
+
+  _openBegin = _head;
+  _openUsed = false;
+
+  return std::tuple<vk::Fence, uint64_t>(fence, region.serial);
+}
+
+// regions complete in submission order, anything older than the front is done
+bool StagingRing::isRegionComplete(uint64_t serial) {
+  while (!_regions.empty() && _device.getFenceStatus(_regions.front().fence) == vk::Result::eSuccess) {
+    reclaimRegion();
+  }
+  return _regions.empty() || serial < _regions.front().serial;
+}
+
+void StagingRing::waitRegion(uint64_t serial) {
+  while (!_regions.empty() && _regions.front().serial <= serial) {
+    reclaimRegion();
+  }
+}
+
+void StagingRing::reclaimRegion() {
+  Region& region = _regions.front();
+  IF_THROW(
+      _device.waitForFences(1, &region.fence, VK_TRUE, UINT64_MAX) != vk::Result::eSuccess,
+      failed to wait for staging region fence...
+      );
+  IF_THROW(
+      _device.resetFences(1, &region.fence) != vk::Result::eSuccess,
+      failed to reset staging region fence...
+      );
+  _freeFences.push_back(region.fence);
+  _regions.pop_front();
+}
@@ -1,32 +1,23 @@
 #include "Structs.hh"
 
+#include <glm/gtc/packing.hpp>
+
 bool QueueFamilyIndices::isComplete() {
   return graphicsFamily.has_value() && presentFamily.has_value();
 }
 
-vk::VertexInputBindingDescription Vertex::getBindingDescription() {
-  vk::VertexInputBindingDescription description{};
-  description.setBinding(0)
-             .setStride(sizeof(Vertex))
-             .setInputRate(vk::VertexInputRate::eVertex);
-
-  return description;
+Vertex Vertex::pack(const glm::vec3& pos, const glm::vec3& color, const glm::vec2& texCoord) {
+  Vertex vertex;
+  vertex.pos = glm::packHalf4x16(glm::vec4(pos, 1.0f));
+  vertex.color = glm::packUnorm4x8(glm::vec4(color, 1.0f));
+  vertex.texCoord = glm::packSnorm2x16(texCoord);
+  return vertex;
 }
 
-std::array<vk::VertexInputAttributeDescription, 3> Vertex::getAttributeDescriptions() {
-  std::array<vk::VertexInputAttributeDescription, 3> descriptions;
-  descriptions[0].setBinding(0)
-                 .setLocation(0)
-                 .setFormat(vk::Format::eR32G32Sfloat)
-                 .setOffset(offsetof(Vertex, pos));
-  descriptions[1].setBinding(0)
-                 .setLocation(1)
-                 .setFormat(vk::Format::eR32G32B32Sfloat)
-                 .setOffset(offsetof(Vertex, color));
-  descriptions[2].setBinding(0)
-                 .setLocation(2)
-                 .setFormat(vk::Format::eR32G32Sfloat)
-                 .setOffset(offsetof(Vertex, texCoord));
-
-  return descriptions;
+InstanceData InstanceData::pack(const glm::mat4& transform, const glm::vec4& tint, uint32_t textureIndex) {
+  InstanceData instance;
+  instance.transform = transform;
+  instance.tint = glm::packUnorm4x8(tint);
+  instance.textureIndex = textureIndex;
+  return instance;
 }
@@ -0,0 +1,441 @@
+#include "TextureImport.hh"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#include "ImageUtils.hh"
+#include "VkUtils.hh"
+#include "Macros.hh"
+
+// stored in front of the encoded levels, a file that does not match is encoded again
+struct TextureCacheHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t sourceHash;
+  uint32_t format;
+  uint32_t width;
+  uint32_t height;
+  uint32_t levelCount;
+};
+
+const uint32_t textureCacheMagic = 0x43545652; // "RVTC"
+// bump when the encoders change so old results are not reused
+const uint32_t textureCacheVersion = 2;
+
+// fnv-1a
+static uint64_t hashBytes(const std::vector<char>& bytes) {
+  uint64_t hash = 0xcbf29ce484222325ull;
+  for (char c : bytes) {
+    hash ^= static_cast<uint8_t>(c);
+    hash *= 0x100000001b3ull;
+  }
+  return hash;
+}
+
+static uint16_t to565(uint32_t r, uint32_t g, uint32_t b) {
+  return static_cast<uint16_t>(((r * 31 + 127) / 255) << 11 | ((g * 63 + 127) / 255) << 5 | ((b * 31 + 127) / 255));
+}
+
+static void from565(uint16_t color, int32_t rgb[3]) {
+  int32_t r = (color >> 11) & 31;
+  int32_t g = (color >> 5) & 63;
+  int32_t b = color & 31;
+  rgb[0] = (r << 3) | (r >> 2);
+  rgb[1] = (g << 2) | (g >> 4);
+  rgb[2] = (b << 3) | (b >> 2);
+}
+
+static void writeLE(uint8_t* out, uint64_t value, uint32_t bytes) {
+  for (uint32_t i = 0; i < bytes; i++) {
+    out[i] = static_cast<uint8_t>(value >> (i * 8));
+  }
+}
+
+// endpoints are the corners of the color bounding box, pulled in a little so the
+// interpolated colors land closer to the pixels, always the 4 color mode
+static void encodeColorBlock(const uint8_t rgba[64], uint8_t out[8]) {
+  int32_t lo[3] = { 255, 255, 255 };
+  int32_t hi[3] = { 0, 0, 0 };
+  for (uint32_t i = 0; i < 16; i++) {
+    for (uint32_t c = 0; c < 3; c++) {
+      lo[c] = std::min<int32_t>(lo[c], rgba[i * 4 + c]);
+      hi[c] = std::max<int32_t>(hi[c], rgba[i * 4 + c]);
+    }
+  }
+  for (uint32_t c = 0; c < 3; c++) {
+    int32_t inset = (hi[c] - lo[c]) / 16;
+    lo[c] += inset;
+    hi[c] -= inset;
+  }
+
+  uint16_t color0 = to565(hi[0], hi[1], hi[2]);
+  uint16_t color1 = to565(lo[0], lo[1], lo[2]);
+  if (color0 < color1) {
+    std::swap(color0, color1);
+  }
+
+  uint32_t indices = 0;
+  if (color0 != color1) {
+    int32_t palette[4][3];
+    from565(color0, palette[0]);
+    from565(color1, palette[1]);
+    for (uint32_t c = 0; c < 3; c++) {
+      palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+      palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+
+    for (uint32_t i = 0; i < 16; i++) {
+      uint32_t best = 0;
+      int32_t bestDistance = INT32_MAX;
+      for (uint32_t p = 0; p < 4; p++) {
+        int32_t distance = 0;
+        for (uint32_t c = 0; c < 3; c++) {
+          int32_t d = rgba[i * 4 + c] - palette[p][c];
+          distance += d * d;
+        }
+        if (distance < bestDistance) {
+          bestDistance = distance;
+          best = p;
+        }
+      }
+      indices |= best << (i * 2);
+    }
+  }
+
+  writeLE(out, color0, 2);
+  writeLE(out + 2, color1, 2);
+  writeLE(out + 4, indices, 4);
+}
+
+// 8 value mode, endpoint 0 is the max so it is always greater unless the block is flat
+static void encodeValueBlock(const uint8_t values[16], uint8_t out[8]) {
+  int32_t hi = *std::max_element(values, values + 16);
+  int32_t lo = *std::min_element(values, values + 16);
+
+  uint64_t indices = 0;
+  if (hi != lo) {
+    int32_t palette[8];
+    palette[0] = hi;
+    palette[1] = lo;
+    for (int32_t i = 2; i < 8; i++) {
+      palette[i] = ((8 - i) * hi + (i - 1) * lo) / 7;
+    }
+
+    for (uint32_t i = 0; i < 16; i++) {
+      uint64_t best = 0;
+      int32_t bestDistance = INT32_MAX;
+      for (uint32_t p = 0; p < 8; p++) {
+        int32_t distance = std::abs(values[i] - palette[p]);
+        if (distance < bestDistance) {
+          bestDistance = distance;
+          best = p;
+        }
+      }
+      indices |= best << (i * 3);
+    }
+  }
+
+  out[0] = static_cast<uint8_t>(hi);
+  out[1] = static_cast<uint8_t>(lo);
+  writeLE(out + 2, indices, 6);
+}
+
+// copies the 4x4 block at (bx, by) out of the image
+static void fetchBlock(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t channels, uint32_t bx, uint32_t by, uint8_t* block) {
+  for (uint32_t y = 0; y < 4; y++) {
+    uint32_t sy = std::min(by * 4 + y, height - 1);
+    for (uint32_t x = 0; x < 4; x++) {
+      uint32_t sx = std::min(bx * 4 + x, width - 1);
+      memcpy(block + (y * 4 + x) * channels, pixels + (static_cast<size_t>(sy) * width + sx) * channels, channels);
+    }
+  }
+}
+
+// blockBytes per 4x4 block, encodeBlock gets the block's pixels with the given channel count
+template<typename F>
+static std::vector<uint8_t> encodeBlocks(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t channels, uint32_t blockBytes, F encodeBlock) {
+  uint32_t blocksX = (width + 3) / 4;
+  uint32_t blocksY = (height + 3) / 4;
+  std::vector<uint8_t> encoded(static_cast<size_t>(blocksX) * blocksY * blockBytes);
+
+  uint8_t block[64];
+  for (uint32_t by = 0; by < blocksY; by++) {
+    for (uint32_t bx = 0; bx < blocksX; bx++) {
+      fetchBlock(pixels, width, height, channels, bx, by, block);
+      encodeBlock(block, encoded.data() + (static_cast<size_t>(by) * blocksX + bx) * blockBytes);
+    }
+  }
+
+  return encoded;
+}
+
+// splits out one channel of a block
+static void extractChannel(const uint8_t* block, uint32_t channels, uint32_t channel, uint8_t values[16]) {
+  for (uint32_t i = 0; i < 16; i++) {
+    values[i] = block[i * channels + channel];
+  }
+}
+
+static std::string cacheFilename(const TextureImportOptions& options, uint64_t sourceHash) {
+  char name[32];
+  snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(sourceHash));
+  return (std::filesystem::path(options.cacheDirectory) / name).string();
+}
+
+// false when there is no usable cache entry for this source
+static bool loadCachedTexture(const std::string& filename, uint64_t sourceHash, TextureData* texture) {
+  std::vector<char> file;
+  try {
+    file = myUtils::readBinaryFile(filename);
+  } catch (std::runtime_error& e) {
+    return false;
+  }
+
+  TextureCacheHeader header;
+  if (file.size() < sizeof(header)) return false;
+  memcpy(&header, file.data(), sizeof(header));
+
+  if (header.magic != textureCacheMagic
+      || header.version != textureCacheVersion
+      || header.sourceHash != sourceHash
+      || header.levelCount == 0
+      || header.levelCount > 32) {
+    return false;
+  }
+
+  size_t offset = sizeof(header);
+  std::vector<uint32_t> sizes(header.levelCount);
+  if (file.size() < offset + sizes.size() * sizeof(uint32_t)) return false;
+  memcpy(sizes.data(), file.data() + offset, sizes.size() * sizeof(uint32_t));
+  offset += sizes.size() * sizeof(uint32_t);
+
+  texture->levels.clear();
+  for (uint32_t size : sizes) {
+    if (file.size() < offset + size) return false;
+    texture->levels.emplace_back(file.data() + offset, file.data() + offset + size);
+    offset += size;
+  }
+
+  texture->format = static_cast<vk::Format>(header.format);
+  texture->width = header.width;
+  texture->height = header.height;
+  texture->channels = 0;
+  return true;
+}
+
+// failing to write only costs encoding again next time, so it is not an error
+static void storeCachedTexture(const std::string& filename, uint64_t sourceHash, const TextureData& texture) {
+  TextureCacheHeader header;
+  header.magic = textureCacheMagic;
+  header.version = textureCacheVersion;
+  header.sourceHash = sourceHash;
+  header.format = static_cast<uint32_t>(texture.format);
+  header.width = texture.width;
+  header.height = texture.height;
+  header.levelCount = static_cast<uint32_t>(texture.levels.size());
+
+  std::vector<char> file(sizeof(header));
+  memcpy(file.data(), &header, sizeof(header));
+  for (const auto& level : texture.levels) {
+    uint32_t size = static_cast<uint32_t>(level.size());
+    file.insert(file.end(), reinterpret_cast<const char*>(&size), reinterpret_cast<const char*>(&size) + sizeof(size));
+  }
+  for (const auto& level : texture.levels) {
+    file.insert(file.end(), level.begin(), level.end());
+  }
+
+  try {
+    std::error_code error;
+    std::filesystem::create_directories(std::filesystem::path(filename).parent_path(), error);
+    myUtils::writeBinaryFile(filename, file);
+  } catch (std::runtime_error& e) {
+  }
+}
+
+static float srgbToLinear(float c) {
+  return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+}
+
+static float linearToSrgb(float c) {
+  return c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+}
+
+template<typename F>
+static std::array<uint8_t, 256> makeTable(F convert) {
+  std::array<uint8_t, 256> table;
+  for (uint32_t i = 0; i < table.size(); i++) {
+    table[i] = static_cast<uint8_t>(convert(i / 255.0f) * 255.0f + 0.5f);
+  }
+  return table;
+}
+
+// BC4/BC5 have no srgb variants, grey going into them is stored linear instead of expanded
+// to srgb rgba, costing some precision in the darks but keeping a quarter of the size
+// alpha is linear already and left alone
+static void linearizeGrey(uint8_t* pixels, size_t pixelCount, uint32_t channels) {
+  static const std::array<uint8_t, 256> toLinear = makeTable(srgbToLinear);
+
+  for (size_t i = 0; i < pixelCount; i++) {
+    pixels[i * channels] = toLinear[pixels[i * channels]];
+  }
+}
+
+// R8G8Srgb decodes both channels, alpha is encoded up front so sampling gives it back
+static void encodeAlphaSrgb(uint8_t* pixels, size_t pixelCount) {
+  static const std::array<uint8_t, 256> toSrgb = makeTable(linearToSrgb);
+
+  for (size_t i = 0; i < pixelCount; i++) {
+    pixels[i * 2 + 1] = toSrgb[pixels[i * 2 + 1]];
+  }
+}
+
+static vk::ComponentMapping componentsFor(uint32_t sourceChannels) {
+  if (sourceChannels == 1) {
+    return vk::ComponentMapping(vk::ComponentSwizzle::eR, vk::ComponentSwizzle::eR, vk::ComponentSwizzle::eR, vk::ComponentSwizzle::eOne);
+  }
+  if (sourceChannels == 2) {
+    return vk::ComponentMapping(vk::ComponentSwizzle::eR, vk::ComponentSwizzle::eR, vk::ComponentSwizzle::eR, vk::ComponentSwizzle::eG);
+  }
+  return vk::ComponentMapping();
+}
+
+namespace myUtils {
+
+  std::vector<uint8_t> encodeBC1(const uint8_t* rgba, uint32_t width, uint32_t height) {
+    return encodeBlocks(rgba, width, height, 4, 8, [](const uint8_t* block, uint8_t* out) {
+      encodeColorBlock(block, out);
+    });
+  }
+
+  std::vector<uint8_t> encodeBC3(const uint8_t* rgba, uint32_t width, uint32_t height) {
+    return encodeBlocks(rgba, width, height, 4, 16, [](const uint8_t* block, uint8_t* out) {
+      uint8_t alpha[16];
+      extractChannel(block, 4, 3, alpha);
+      encodeValueBlock(alpha, out);
+      encodeColorBlock(block, out + 8);
+    });
+  }
+
+  std::vector<uint8_t> encodeBC4(const uint8_t* r, uint32_t width, uint32_t height) {
+    return encodeBlocks(r, width, height, 1, 8, [](const uint8_t* block, uint8_t* out) {
+      encodeValueBlock(block, out);
+    });
+  }
+
+  std::vector<uint8_t> encodeBC5(const uint8_t* rg, uint32_t width, uint32_t height) {
+    return encodeBlocks(rg, width, height, 2, 16, [](const uint8_t* block, uint8_t* out) {
+      uint8_t values[16];
+      extractChannel(block, 2, 0, values);
+      encodeValueBlock(values, out);
+      extractChannel(block, 2, 1, values);
+      encodeValueBlock(values, out + 8);
+    });
+  }
+
+  TextureData importTexture(const std::string& filename, const TextureImportOptions& options) {
+    std::vector<char> source = readBinaryFile(filename);
+    const stbi_uc* sourceData = reinterpret_cast<const stbi_uc*>(source.data());
+    int sourceSize = static_cast<int>(source.size());
+
+    int width, height, sourceChannels;
+    IF_THROW(
+        !stbi_info_from_memory(sourceData, sourceSize, &width, &height, &sourceChannels),
+        failed to read texture header...
+        );
+
+    // rgb is padded to rgba, there are no 3 channel formats worth sampling from
+    uint32_t channels = sourceChannels <= 2 ? sourceChannels : 4;
+
+    TextureData texture;
+    texture.components = componentsFor(sourceChannels);
+
+    uint64_t sourceHash = hashBytes(source);
+    std::string cachedFilename = cacheFilename(options, sourceHash);
+    if (options.blockCompression && loadCachedTexture(cachedFilename, sourceHash, &texture)) {
+      return texture;
+    }
+
+    int loadedWidth, loadedHeight, loadedChannels;
+    stbi_uc* pixels = stbi_load_from_memory(sourceData, sourceSize, &loadedWidth, &loadedHeight, &loadedChannels, channels);
+    IF_THROW(
+        !pixels,
+        failed to load texture iamge...
+        );
+
+    texture.width = width;
+    texture.height = height;
+
+    // grey is sampled as srgb like color, from R8Srgb/R8G8Srgb when the device can,
+    // otherwise it is converted to linear before it lands in a unorm format
+    size_t pixelCount = static_cast<size_t>(width) * height;
+    bool srgbGrey = !options.blockCompression && options.srgbGrey;
+    if (channels == 2 && srgbGrey) {
+      encodeAlphaSrgb(pixels, pixelCount);
+    } else if (channels <= 2 && !srgbGrey) {
+      linearizeGrey(pixels, pixelCount, channels);
+    }
+
+    if (!options.blockCompression) {
+      texture.channels = channels;
+      texture.format = channels == 1 ? (srgbGrey ? vk::Format::eR8Srgb : vk::Format::eR8Unorm)
+                     : channels == 2 ? (srgbGrey ? vk::Format::eR8G8Srgb : vk::Format::eR8G8Unorm)
+                     : vk::Format::eR8G8B8A8Srgb;
+      texture.levels.emplace_back(pixels, pixels + static_cast<size_t>(width) * height * channels);
+      stbi_image_free(pixels);
+      return texture;
+    }
+
+    bool opaque = true;
+    if (channels == 4) {
+      for (size_t i = 0; i < static_cast<size_t>(width) * height; i++) {
+        if (pixels[i * 4 + 3] != 255) {
+          opaque = false;
+          break;
+        }
+      }
+    }
+
+    std::vector<uint8_t> (*encode)(const uint8_t*, uint32_t, uint32_t);
+    if (channels == 1) {
+      texture.format = vk::Format::eBc4UnormBlock;
+      encode = encodeBC4;
+    } else if (channels == 2) {
+      texture.format = vk::Format::eBc5UnormBlock;
+      encode = encodeBC5;
+    } else if (opaque) {
+      texture.format = vk::Format::eBc1RgbSrgbBlock;
+      encode = encodeBC1;
+    } else {
+      texture.format = vk::Format::eBc3SrgbBlock;
+      encode = encodeBC3;
+    }
+
+    // compressed formats cannot be blitted, so the whole chain is built and encoded here
+    std::vector<std::vector<uint8_t>> mips = generateMipChain(pixels, width, height, channels);
+
+    uint32_t mipWidth = width;
+    uint32_t mipHeight = height;
+    texture.levels.push_back(encode(pixels, mipWidth, mipHeight));
+    for (const auto& mip : mips) {
+      mipWidth = std::max(mipWidth / 2, 1u);
+      mipHeight = std::max(mipHeight / 2, 1u);
+      texture.levels.push_back(encode(mip.data(), mipWidth, mipHeight));
+    }
+
+    stbi_image_free(pixels);
+
+    storeCachedTexture(cachedFilename, sourceHash, texture);
+
+    return texture;
+  }
+
+};
@@ -0,0 +1,49 @@
+#include "ThreadPool.hh"
+
+#include <algorithm>
+
+ThreadPool::~ThreadPool() {
+  cleanup();
+}
+
+void ThreadPool::init(uint32_t threadCount) {
+  if (threadCount == 0) {
+    threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+  }
+
+  _stopping = false;
+  for (uint32_t i = 0; i < threadCount; i++) {
+    _threads.emplace_back(&ThreadPool::workerLoop, this);
+  }
+}
+
+void ThreadPool::cleanup() {
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stopping = true;
+  }
+  _jobAvailable.notify_all();
+
+  for (auto& thread : _threads) {
+    thread.join();
+  }
+  _threads.clear();
+}
+
+uint32_t ThreadPool::getThreadCount() const {
+  return static_cast<uint32_t>(_threads.size());
+}
+
+void ThreadPool::workerLoop() {
+  while (true) {
+    std::function<void()> job;
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _jobAvailable.wait(lock, [this]() { return _stopping || !_jobs.empty(); });
+      if (_jobs.empty()) return;
+      job = std::move(_jobs.front());
+      _jobs.pop_front();
+    }
+    job();
+  }
+}
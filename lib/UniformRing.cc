@@ -0,0 +1,46 @@
+#include "UniformRing.hh"
+
+#include <cstring>
+
+#include "RenderAssets.hh"
+#include "Macros.hh"
+
+void UniformRing::init(RenderAssets* assets, vk::PhysicalDevice gpu, vk::DeviceSize frameSize, uint32_t framesInFlight) {
+  _assets = assets;
+  _alignment = gpu.getProperties().limits.minUniformBufferOffsetAlignment;
+  _frameSize = (frameSize + _alignment - 1) / _alignment * _alignment;
+
+  vk::DeviceSize bufferSize = _frameSize * framesInFlight;
+  _buffer = _assets->createBuffer(
+      bufferSize, 
+      vk::BufferUsageFlagBits::eUniformBuffer,
+      vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+
+  void* data;
+  _assets->mapMemory(_buffer, bufferSize, &data);
+  _mapped = static_cast<char*>(data);
+
+  beginFrame(0);
+}
+
+void UniformRing::beginFrame(uint32_t frame) {
+  _head = _frameSize * frame;
+  _frameEnd = _head + _frameSize;
+}
+
+uint32_t UniformRing::push(const void* data, vk::DeviceSize size) {
+  IF_THROW(
+      _head + size > _frameEnd,
+      uniform ring frame region is full...
+      );
+
+  vk::DeviceSize offset = _head;
+  memcpy(_mapped + offset, data, size);
+  _head = (offset + size + _alignment - 1) / _alignment * _alignment;
+
+  return static_cast<uint32_t>(offset);
+}
+
+BufferHandle UniformRing::getBuffer() const {
+  return _buffer;
+}
@@ -0,0 +1,408 @@
+#include "UploadBatch.hh"
+
+#include <algorithm>
+#include <tuple>
+
+#include "StagingRing.hh"
+#include "Macros.hh"
+
+void UploadBatch::init(vk::Device device, vk::Queue queue, uint32_t queueFamily, uint32_t graphicsFamily, StagingRing* stagingRing) {
+  _device = device;
+  _queue = queue;
+  _queueFamily = queueFamily;
+  _graphicsFamily = graphicsFamily;
+  _stagingRing = stagingRing;
+
+  vk::CommandPoolCreateInfo createInfo;
+  createInfo.setFlags(vk::CommandPoolCreateFlagBits::eTransient | vk::CommandPoolCreateFlagBits::eResetCommandBuffer);
+  createInfo.setQueueFamilyIndex(_queueFamily);
+
+  _commandPool = _device.createCommandPool(createInfo);
+  CHECK_NULL(_commandPool);
+}
+
+void UploadBatch::cleanup() {
+  for (const auto& pending : _pending) {
+    wait(pending.ticket);
+  }
+  _pending.clear();
+  _freeCommandBuffers.clear();
+  _acquires.clear();
+  _recording = nullptr;
+
+  _device.destroyCommandPool(_commandPool);
+}
+
+void UploadBatch::copyBuffer(vk::Buffer src, vk::Buffer dst, const vk::BufferCopy& region) {
+  getRecordingBuffer().copyBuffer(src, dst, region);
+
+  if (!ownershipTransfer()) return;
+
+  // only the written range changes owner, the rest of a shared buffer may already be
+  // owned by the graphics family and in use there
+  if (!_writtenRanges.empty() && _writtenRanges.back().buffer == dst &&
+      _writtenRanges.back().offset + _writtenRanges.back().size == region.dstOffset) {
+    _writtenRanges.back().size += region.size;
+  } else {
+    _writtenRanges.push_back({ dst, region.dstOffset, region.size });
+  }
+}
+
+void UploadBatch::copyBufferToImage(vk::Buffer src, vk::Image dst, const vk::BufferImageCopy& region) {
+  getRecordingBuffer().copyBufferToImage(src, dst, vk::ImageLayout::eTransferDstOptimal, 1, &region);
+}
+
+void UploadBatch::transitionImageLayout(
+    vk::Image image, 
+    vk::ImageLayout oldLayout, 
+    vk::ImageLayout newLayout, 
+    uint32_t baseMipLevel, 
+    uint32_t levelCount) {
+  vk::ImageMemoryBarrier barrier;
+  barrier.setOldLayout(oldLayout)
+         .setNewLayout(newLayout)
+         .setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+         .setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+         .setImage(image)
+         .setSubresourceRange(vk::ImageSubresourceRange(
+               vk::ImageAspectFlagBits::eColor, 
+               baseMipLevel, levelCount, 0, 1
+               ));
+
+  vk::PipelineStageFlags sourceStage, dstStage;
+
+  if (oldLayout == vk::ImageLayout::eUndefined && newLayout == vk::ImageLayout::eTransferDstOptimal) {
+    barrier.setSrcAccessMask(vk::AccessFlags(0))
+           .setDstAccessMask(vk::AccessFlagBits::eTransferWrite);
+    sourceStage = vk::PipelineStageFlagBits::eTopOfPipe;
+    dstStage = vk::PipelineStageFlagBits::eTransfer;
+  } else if (oldLayout == vk::ImageLayout::eTransferDstOptimal && newLayout == vk::ImageLayout::eShaderReadOnlyOptimal) {
+    barrier.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite)
+           .setDstAccessMask(vk::AccessFlagBits::eShaderRead);
+    sourceStage = vk::PipelineStageFlagBits::eTransfer;
+    dstStage = vk::PipelineStageFlagBits::eFragmentShader;
+
+    // the layout change happens as part of the ownership transfer, the release half
+    // runs on the transfer queue, the acquire half is recorded by acquire()
+    if (ownershipTransfer()) {
+      barrier.setSrcQueueFamilyIndex(_queueFamily)
+             .setDstQueueFamilyIndex(_graphicsFamily);
+
+      vk::ImageMemoryBarrier acquireBarrier = barrier;
+      acquireBarrier.setSrcAccessMask(vk::AccessFlags(0));
+      _recordingAcquire.imageBarriers.push_back(acquireBarrier);
+
+      barrier.setDstAccessMask(vk::AccessFlags(0));
+      dstStage = vk::PipelineStageFlagBits::eBottomOfPipe;
+    }
+  } else {
+    throw std::runtime_error("unsupported old/newLayout transfer...");
+  }
+
+  getRecordingBuffer().pipelineBarrier(
+      sourceStage, dstStage, 
+      vk::DependencyFlags(0), 
+      0, nullptr, 
+      0, nullptr, 
+      1, &barrier
+      );
+}
+
+// every level must be in TransferDstOptimal with level 0 written,
+// leaves the whole chain in ShaderReadOnlyOptimal
+void UploadBatch::generateMipmaps(vk::Image image, uint32_t width, uint32_t height, uint32_t mipLevels) {
+  MipChain chain = { image, width, height, mipLevels };
+
+  if (!ownershipTransfer()) {
+    recordMipChain(getRecordingBuffer(), chain);
+    return;
+  }
+
+  // hand the image over in TransferDstOptimal, the blits run after the acquire
+  vk::ImageMemoryBarrier barrier;
+  barrier.setOldLayout(vk::ImageLayout::eTransferDstOptimal)
+         .setNewLayout(vk::ImageLayout::eTransferDstOptimal)
+         .setSrcAccessMask(vk::AccessFlagBits::eTransferWrite)
+         .setDstAccessMask(vk::AccessFlags(0))
+         .setSrcQueueFamilyIndex(_queueFamily)
+         .setDstQueueFamilyIndex(_graphicsFamily)
+         .setImage(image)
+         .setSubresourceRange(vk::ImageSubresourceRange(
+               vk::ImageAspectFlagBits::eColor, 
+               0, mipLevels, 0, 1
+               ));
+
+  getRecordingBuffer().pipelineBarrier(
+      vk::PipelineStageFlagBits::eTransfer, 
+      vk::PipelineStageFlagBits::eBottomOfPipe, 
+      vk::DependencyFlags(0), 
+      0, nullptr, 
+      0, nullptr, 
+      1, &barrier
+      );
+
+  barrier.setSrcAccessMask(vk::AccessFlags(0))
+         .setDstAccessMask(vk::AccessFlagBits::eTransferRead | vk::AccessFlagBits::eTransferWrite);
+  _recordingAcquire.imageBarriers.push_back(barrier);
+  _recordingAcquire.mipChains.push_back(chain);
+}
+
+// ticket 0 means nothing was recorded and is always complete
+uint64_t UploadBatch::submit() {
+  if (!_recording) {
+    return 0;
+  }
+
+  if (ownershipTransfer()) {
+    // release every written buffer range to the graphics family
+    std::vector<vk::BufferMemoryBarrier> releaseBarriers;
+    for (const auto& range : _writtenRanges) {
+      vk::BufferMemoryBarrier barrier;
+      barrier.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite)
+             .setDstAccessMask(vk::AccessFlags(0))
+             .setSrcQueueFamilyIndex(_queueFamily)
+             .setDstQueueFamilyIndex(_graphicsFamily)
+             .setBuffer(range.buffer)
+             .setOffset(range.offset)
+             .setSize(range.size);
+      releaseBarriers.push_back(barrier);
+
+      barrier.setSrcAccessMask(vk::AccessFlags(0))
+             .setDstAccessMask(
+                 vk::AccessFlagBits::eVertexAttributeRead | 
+                 vk::AccessFlagBits::eIndexRead | 
+                 vk::AccessFlagBits::eUniformRead | 
+                 vk::AccessFlagBits::eShaderRead
+                 );
+      _recordingAcquire.bufferBarriers.push_back(barrier);
+    }
+    _writtenRanges.clear();
+
+    if (!releaseBarriers.empty()) {
+      _recording.pipelineBarrier(
+          vk::PipelineStageFlagBits::eTransfer, 
+          vk::PipelineStageFlagBits::eBottomOfPipe, 
+          vk::DependencyFlags(0), 
+          0, nullptr, 
+          static_cast<uint32_t>(releaseBarriers.size()), releaseBarriers.data(), 
+          0, nullptr
+          );
+    }
+  } else {
+    // make every transfer write visible to whatever reads uploads later on this queue
+    vk::MemoryBarrier barrier;
+    barrier.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite)
+           .setDstAccessMask(
+               vk::AccessFlagBits::eVertexAttributeRead | 
+               vk::AccessFlagBits::eIndexRead | 
+               vk::AccessFlagBits::eUniformRead | 
+               vk::AccessFlagBits::eShaderRead
+               );
+
+    _recording.pipelineBarrier(
+        vk::PipelineStageFlagBits::eTransfer, 
+        vk::PipelineStageFlagBits::eVertexInput | vk::PipelineStageFlagBits::eVertexShader | vk::PipelineStageFlagBits::eFragmentShader | vk::PipelineStageFlagBits::eComputeShader, 
+        vk::DependencyFlags(0), 
+        1, &barrier, 
+        0, nullptr, 
+        0, nullptr
+        );
+  }
+
+  _recording.end();
+
+  // the staging bytes of this batch are released with the same fence
+  vk::Fence fence;
+  uint64_t ticket;
+  std::tie(fence, ticket) = _stagingRing->closeRegion();
+
+  vk::SubmitInfo submitInfo;
+  submitInfo.setCommandBuffers(_recording);
+
+  _queue.submit(submitInfo, fence);
+
+  _pending.push_back({ _recording, ticket });
+  _recording = nullptr;
+
+  if (ownershipTransfer()) {
+    _recordingAcquire.ticket = ticket;
+    _acquires.push_back(std::move(_recordingAcquire));
+    _recordingAcquire = Acquire();
+  } else {
+    _readyTicket = ticket;
+  }
+
+  return ticket;
+}
+
+// records the acquire half of every finished batch, in submission order, must be outside a render pass
+// the host saw the batch fence signal, which already orders the release before this command buffer
+void UploadBatch::acquire(vk::CommandBuffer graphicsCommandBuffer) {
+  while (!_acquires.empty() && isComplete(_acquires.front().ticket)) {
+    Acquire& acquire = _acquires.front();
+
+    if (!acquire.bufferBarriers.empty() || !acquire.imageBarriers.empty()) {
+      graphicsCommandBuffer.pipelineBarrier(
+          vk::PipelineStageFlagBits::eTopOfPipe, 
+          vk::PipelineStageFlagBits::eTransfer | 
+          vk::PipelineStageFlagBits::eVertexInput | 
+          vk::PipelineStageFlagBits::eVertexShader | 
+          vk::PipelineStageFlagBits::eFragmentShader | 
+          vk::PipelineStageFlagBits::eComputeShader, 
+          vk::DependencyFlags(0), 
+          0, nullptr, 
+          static_cast<uint32_t>(acquire.bufferBarriers.size()), acquire.bufferBarriers.data(), 
+          static_cast<uint32_t>(acquire.imageBarriers.size()), acquire.imageBarriers.data()
+          );
+    }
+
+    for (const auto& chain : acquire.mipChains) {
+      recordMipChain(graphicsCommandBuffer, chain);
+    }
+
+    _readyTicket = acquire.ticket;
+    _acquires.pop_front();
+  }
+}
+
+// the gpu finished executing the batch
+bool UploadBatch::isComplete(uint64_t ticket) {
+  return ticket == 0 || _stagingRing->isRegionComplete(ticket);
+}
+
+// graphics work recorded from now on may use what the batch uploaded
+bool UploadBatch::isReady(uint64_t ticket) const {
+  return ticket <= _readyTicket;
+}
+
+void UploadBatch::wait(uint64_t ticket) {
+  if (ticket == 0) return;
+  _stagingRing->waitRegion(ticket);
+}
+
+bool UploadBatch::ownershipTransfer() const {
+  return _queueFamily != _graphicsFamily;
+}
+
+vk::CommandBuffer UploadBatch::getRecordingBuffer() {
+  if (_recording) {
+    return _recording;
+  }
+
+  recycleCommandBuffers();
+
+  if (_freeCommandBuffers.empty()) {
+    vk::CommandBufferAllocateInfo allocInfo;
+    allocInfo.setLevel(vk::CommandBufferLevel::ePrimary)
+             .setCommandPool(_commandPool)
+             .setCommandBufferCount(1);
+
+    _recording = _device.allocateCommandBuffers(allocInfo)[0];
+  } else {
+    _recording = _freeCommandBuffers.back();
+    _freeCommandBuffers.pop_back();
+    _recording.reset();
+  }
+
+  vk::CommandBufferBeginInfo beginInfo;
+  beginInfo.setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
+
+  _recording.begin(beginInfo);
+
+  return _recording;
+}
+
+void UploadBatch::recycleCommandBuffers() {
+  for (size_t i = 0; i < _pending.size();) {
+    if (isComplete(_pending[i].ticket)) {
+      _freeCommandBuffers.push_back(_pending[i].commandBuffer);
+      _pending[i] = _pending.back();
+      _pending.pop_back();
+    } else {
+      i++;
+    }
+  }
+}
+
+// each level is blitted from the one above it, which is then moved to ShaderReadOnlyOptimal
+// so the level being read is the only one in TransferSrcOptimal at any time
+void UploadBatch::recordMipChain(vk::CommandBuffer commandBuffer, const MipChain& chain) {
+  vk::ImageMemoryBarrier barrier;
+  barrier.setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+         .setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+         .setImage(chain.image);
+
+  int32_t mipWidth = static_cast<int32_t>(chain.width);
+  int32_t mipHeight = static_cast<int32_t>(chain.height);
+
+  for (uint32_t i = 1; i < chain.mipLevels; i++) {
+    barrier.setOldLayout(vk::ImageLayout::eTransferDstOptimal)
+           .setNewLayout(vk::ImageLayout::eTransferSrcOptimal)
+           .setSrcAccessMask(vk::AccessFlagBits::eTransferWrite)
+           .setDstAccessMask(vk::AccessFlagBits::eTransferRead)
+           .setSubresourceRange(vk::ImageSubresourceRange(
+                 vk::ImageAspectFlagBits::eColor, 
+                 i - 1, 1, 0, 1
+                 ));
+
+    commandBuffer.pipelineBarrier(
+        vk::PipelineStageFlagBits::eTransfer, 
+        vk::PipelineStageFlagBits::eTransfer, 
+        vk::DependencyFlags(0), 
+        0, nullptr, 
+        0, nullptr, 
+        1, &barrier
+        );
+
+    int32_t nextWidth = std::max(mipWidth / 2, 1);
+    int32_t nextHeight = std::max(mipHeight / 2, 1);
+
+    vk::ImageBlit blit;
+    blit.setSrcOffsets({ vk::Offset3D(0, 0, 0), vk::Offset3D(mipWidth, mipHeight, 1) })
+        .setSrcSubresource(vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, i - 1, 0, 1))
+        .setDstOffsets({ vk::Offset3D(0, 0, 0), vk::Offset3D(nextWidth, nextHeight, 1) })
+        .setDstSubresource(vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, i, 0, 1));
+
+    commandBuffer.blitImage(
+        chain.image, vk::ImageLayout::eTransferSrcOptimal, 
+        chain.image, vk::ImageLayout::eTransferDstOptimal, 
+        1, &blit, 
+        vk::Filter::eLinear
+        );
+
+    barrier.setOldLayout(vk::ImageLayout::eTransferSrcOptimal)
+           .setNewLayout(vk::ImageLayout::eShaderReadOnlyOptimal)
+           .setSrcAccessMask(vk::AccessFlagBits::eTransferRead)
+           .setDstAccessMask(vk::AccessFlagBits::eShaderRead);
+
+    commandBuffer.pipelineBarrier(
+        vk::PipelineStageFlagBits::eTransfer, 
+        vk::PipelineStageFlagBits::eFragmentShader, 
+        vk::DependencyFlags(0), 
+        0, nullptr, 
+        0, nullptr, 
+        1, &barrier
+        );
+
+    mipWidth = nextWidth;
+    mipHeight = nextHeight;
+  }
+
+  barrier.setOldLayout(vk::ImageLayout::eTransferDstOptimal)
+         .setNewLayout(vk::ImageLayout::eShaderReadOnlyOptimal)
+         .setSrcAccessMask(vk::AccessFlagBits::eTransferWrite)
+         .setDstAccessMask(vk::AccessFlagBits::eShaderRead)
+         .setSubresourceRange(vk::ImageSubresourceRange(
+               vk::ImageAspectFlagBits::eColor, 
+               chain.mipLevels - 1, 1, 0, 1
+               ));
+
+  commandBuffer.pipelineBarrier(
+      vk::PipelineStageFlagBits::eTransfer, 
+      vk::PipelineStageFlagBits::eFragmentShader, 
+      vk::DependencyFlags(0), 
+      0, nullptr, 
+      0, nullptr, 
+      1, &barrier
+      );
+}
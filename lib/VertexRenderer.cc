@@ -1,29 +1,48 @@
 #include "VertexRenderer.hh"
 
+#include <algorithm>
 #include <chrono>
 #define GLM_FORCE_RADIANS
 #include <glm/gtc/matrix_transform.hpp>
 
-#define STB_IMAGE_IMPLEMENTATION
-#include <stb_image.h>
-
 #include "VulkanInstance.hh"
 #include "RenderAssets.hh"
 #include "Structs.hh"
 #include "VkUtils.hh"
+#include "ImageUtils.hh"
 #include "Macros.hh"
 
-const std::vector<Vertex> vertices = {
-  { { -0.5f, -0.5f }, { 1.0f, 0.0f, 0.0f }, { 1.0f, 0.0f } },
-  { {  0.5f, -0.5f }, { 0.0f, 1.0f, 0.0f }, { 0.0f, 0.0f } },
-  { {  0.5f,  0.5f }, { 0.0f, 0.0f, 1.0f }, { 0.0f, 1.0f } },
-  { { -0.5f,  0.5f }, { 1.0f, 0.0f, 1.0f }, { 1.0f, 1.0f } },
+const std::vector<Vertex> quadVertices = {
+  Vertex::pack({ -0.5f, -0.5f, 0.0f }, { 1.0f, 0.0f, 0.0f }, { 1.0f, 0.0f }),
+  Vertex::pack({  0.5f, -0.5f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { 0.0f, 0.0f }),
+  Vertex::pack({  0.5f,  0.5f, 0.0f }, { 0.0f, 0.0f, 1.0f }, { 0.0f, 1.0f }),
+  Vertex::pack({ -0.5f,  0.5f, 0.0f }, { 1.0f, 0.0f, 1.0f }, { 1.0f, 1.0f }),
 };
 
-const std::vector<uint16_t> indices = {
+const std::vector<uint32_t> quadIndices = {
   0, 1, 2, 2, 3, 0
 };
 
+void Renderer::setMeshFiles(const std::vector<std::string>& files) {
+  _meshFiles = files;
+}
+
+void Renderer::setInstances(const std::vector<InstanceData>& instances) {
+  _instances = instances;
+}
+
+void Renderer::setDrawMode(DrawMode mode) {
+  _drawMode = mode;
+}
+
+void Renderer::setFrustumCulling(bool v) {
+  _frustumCulling = v;
+}
+
+void Renderer::setParallelRecording(bool v) {
+  _parallelRecording = v;
+}
+
 void Renderer::init(VulkanInstance* instance, RenderAssets* assets) {
   _instance = instance;
   _assets = assets;
@@ -31,12 +50,33 @@ void Renderer::init(VulkanInstance* instance, RenderAssets* assets) {
   _device = _instance->getLogicalDevice();
   _gpu = _instance->getGPU();
 
-  createTextureImage();
-  _assets->createImageView(_imageIndex.value());
-  allocateVertexBuffer();
-  allocateIndexBuffer();
+  _threadPool.init();
+
+  // textures decode and meshes parse on the pool at the same time, each one is
+  // uploaded and flushed as soon as it is done
+  // only the textures are waited for here, meshes still parsing are picked up by drawFrame
+  // nothing waits on the uploads either, drawFrame starts drawing once they are ready
+  requestTextures();
+  requestMeshes();
+  uploadTextures();
+  // after the textures, instance texture indices are checked against them
+  uploadInstances();
+  uploadMeshes();
   allocateUniformBuffer();
-  _assets->updateDescriptorSets(_uniformIndex.value(), _imageIndex.value());
+  _assets->updateDescriptorSets(_uniformRing.getBuffer());
+  allocateMeshBuffers(&_meshBuffers);
+  updateCullDescriptorSets();
+  if (_drawMode == DrawMode::eDirect && _parallelRecording) {
+    _recordingPool.init();
+    _recorder.init(_device, _instance->getGraphicsQueueFamily(), &_recordingPool, _instance->getFramesInFlight());
+  }
+}
+
+void Renderer::cleanup() {
+  _device.waitIdle();
+  _recorder.cleanup();
+  _recordingPool.cleanup();
+  _threadPool.cleanup();
 }
 
 void Renderer::drawFrame() {
@@ -44,10 +84,43 @@ void Renderer::drawFrame() {
   uint32_t imageIndex = _instance->acquireImage();
 
   _instance->waitForFence();
-
-  updateUniformBuffer(currentFrame);
+  _assets->collectGarbage();
+
+  // meshes that streamed in get buffers of their own, frames keep drawing from the current
+  // ones until the new bounds are uploaded, more meshes wait for the next swap
+  uploadMeshes();
+  if (!_hasPendingMeshBuffers && _loadedMeshes.size() != _meshBuffers.meshes.size()) {
+    allocateMeshBuffers(&_pendingMeshBuffers);
+    _hasPendingMeshBuffers = true;
+  }
+  if (_hasPendingMeshBuffers && _assets->isUploadReady(_pendingMeshBuffers.boundsTicket)) {
+    swapMeshBuffers();
+  }
+
+  bool parallel = _drawMode == DrawMode::eDirect && _parallelRecording;
+  if (parallel) {
+    _recorder.beginFrame(currentFrame);
+  }
+
+  _uniformRing.beginFrame(currentFrame);
+  _viewUniformOffset = updateUniformBuffer();
 
   vk::CommandBuffer commandBuffer = _instance->getCommandBufferBegin(); {
+    _assets->acquireUploads(commandBuffer);
+
+    bool ready = 
+      _assets->isUploadReady(_uploadTicket) && 
+      _assets->isUploadReady(_instanceTicket) && 
+      _assets->isUploadReady(_meshBuffers.boundsTicket);
+    bool culled = _drawMode == DrawMode::eIndirect && _frustumCulling;
+    uint32_t instanceCount = static_cast<uint32_t>(_instances.size());
+
+    if (ready && culled && !_meshBuffers.meshes.empty()) {
+      uint32_t cullPass = _instance->beginTimestamp(commandBuffer, "cull");
+      recordCulling(commandBuffer, currentFrame, instanceCount);
+      _instance->endTimestamp(commandBuffer, cullPass);
+    }
+
     vk::Extent2D swapChainExtent = _instance->getSwapChainExtent();
 
     vk::RenderPassBeginInfo renderPassInfo;
@@ -62,37 +135,27 @@ void Renderer::drawFrame() {
     vk::ClearValue clearColor(vk::ClearColorValue().setFloat32({0.0f, 0.0f, 0.0f, 0.5f}));
     renderPassInfo.setClearValues(clearColor);
 
-    commandBuffer.beginRenderPass(renderPassInfo, vk::SubpassContents::eInline);
-
-    commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, _assets->getGraphicsPipeline());
-
-    std::vector<vk::Buffer> vertexBuffers = { _assets->getBuffer(_vertexIndex.value()) };
-    vk::Buffer indexBuffer = _assets->getBuffer(_indexIndex.value());
-    std::vector<vk::DeviceSize> offsets = { 0 };
-
-    commandBuffer.bindVertexBuffers(0, 1, vertexBuffers.data(), offsets.data());
-    commandBuffer.bindIndexBuffer(indexBuffer, 0, vk::IndexType::eUint16);
+    uint32_t mainPass = _instance->beginTimestamp(commandBuffer, "main");
 
-    vk::Viewport viewport;
-    viewport.setX(0.0f);
-    viewport.setY(0.0f);
-    viewport.setWidth(static_cast<float>(swapChainExtent.width));
-    viewport.setHeight(static_cast<float>(swapChainExtent.height));
-    viewport.setMinDepth(0.0f);
-    viewport.setMaxDepth(1.0f);
-    
-    commandBuffer.setViewport(0, 1, &viewport);
+    // secondary buffers can't be mixed with inline commands in the same subpass
+    parallel = parallel && ready;
+    commandBuffer.beginRenderPass(renderPassInfo, parallel ? vk::SubpassContents::eSecondaryCommandBuffers : vk::SubpassContents::eInline);
 
-    vk::Rect2D scissor;
-    scissor.setOffset(vk::Offset2D(0, 0));
-    scissor.setExtent(swapChainExtent);
+    if (parallel) {
+      recordParallelDraws(commandBuffer, currentFrame, imageIndex, instanceCount);
+    } else if (ready) {
+      bindDrawState(commandBuffer, currentFrame, culled);
 
-    commandBuffer.setScissor(0, 1, &scissor);
-
-    commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, _assets->getGraphicsPipelineLayout(), 0, 1, &_assets->getDescriptorSet()[currentFrame], 0, nullptr);
-    commandBuffer.drawIndexed(static_cast<uint32_t>(indices.size()), 1, 0, 0, 0);
+      if (_drawMode == DrawMode::eIndirect) {
+        recordIndirectDraws(commandBuffer, currentFrame, instanceCount, culled);
+      } else {
+        recordDirectDraws(commandBuffer, instanceCount, 0, static_cast<uint32_t>(_meshBuffers.meshes.size()));
+      }
+    }
 
     commandBuffer.endRenderPass();
+
+    _instance->endTimestamp(commandBuffer, mainPass);
   } _instance->getCommandBufferEnd();
 
   _instance->applyGraphicsQueue();
@@ -102,172 +165,493 @@ void Renderer::drawFrame() {
   _instance->currentFrameInc();
 }
 
-void Renderer::createTextureImage() {
-  int texWidth, texHeight, texChannels;
-  stbi_uc* pixels = stbi_load("../resources/texture.jpg", &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-  vk::DeviceSize imageSize = texWidth * texHeight * 4;
+// decoding runs on the pool, textures are handed back by uploadTextures() in the order they finish
+void Renderer::requestTextures() {
+  const std::vector<std::string> textureFiles = {
+    "../resources/texture.jpg",
+  };
 
-  IF_THROW(
-      !pixels,
-      failed to load texture iamge...
-      );
+  TextureImportOptions options;
+  options.blockCompression = _assets->supportsBlockCompression();
+  options.srgbGrey = _assets->supportsSrgbGrey();
 
-  vk::Buffer stagingBuffer;
-  vk::DeviceMemory stagingMemory;
-  std::tie(stagingBuffer, stagingMemory) = myUtils::createStagingBuffer(imageSize, 
-      _device, 
-      _gpu);
-
-  void* data;
-  auto result = _device.mapMemory(stagingMemory, 0, imageSize, vk::MemoryMapFlags(0), &data);
-    IF_THROW(
-        result != vk::Result::eSuccess, 
-        failed to map texture staging mem...
-        );
-    memcpy(data, pixels, imageSize);
-  _device.unmapMemory(stagingMemory);
+  _textureLoader.init(&_threadPool);
+  for (const auto& filename : textureFiles) {
+    _textureLoader.request([filename, options]() { return myUtils::importTexture(filename, options); });
+  }
+}
 
-  stbi_image_free(pixels);
+// parsing runs on the pool, meshes are handed back by uploadMeshes() in the order they finish
+void Renderer::requestMeshes() {
+  _geometry.init(_assets, GEOMETRY_BLOCK_SIZE);
+  _meshLoader.init(&_threadPool);
+  for (const auto& filename : _meshFiles) {
+    _meshLoader.request([filename]() { return myUtils::importMesh(filename); });
+  }
+}
+
+bool Renderer::isLoaded() const {
+  if (!_meshLoader.done() || _loadedMeshes.size() != _meshBuffers.meshes.size()) return false;
+  return std::all_of(_loadedMeshes.begin(), _loadedMeshes.end(), [this](const Mesh& mesh) {
+    return _assets->isUploadReady(mesh.uploadTicket);
+  });
+}
+
+// uploads the meshes that finished parsing since the last call without waiting for the rest
+void Renderer::uploadMeshes() {
+  if (_meshFiles.empty()) {
+    if (!_loadedMeshes.empty()) return;
+
+    MeshData quad;
+    quad.vertices = quadVertices;
+    myUtils::packIndices(quadIndices, static_cast<uint32_t>(quadVertices.size()), &quad);
+    myUtils::computeBounds(&quad);
+    uploadMesh(quad);
+    return;
+  }
+
+  size_t meshCount = _loadedMeshes.size();
+  uint32_t id;
+  std::vector<MeshData> meshes;
+  while (_meshLoader.poll(&id, &meshes)) {
+    for (const auto& mesh : meshes) {
+      if (mesh.indexCount == 0) continue;
+      uploadMesh(mesh);
+    }
+  }
+  if (_loadedMeshes.size() == meshCount) return;
+
+  // meshes sharing a block end up next to each other, so are their indirect commands
+  std::stable_sort(_loadedMeshes.begin(), _loadedMeshes.end(), [](const Mesh& a, const Mesh& b) {
+    return a.geometry.block < b.geometry.block;
+  });
+}
+
+void Renderer::uploadMesh(const MeshData& data) {
+  Mesh mesh;
+  mesh.geometry = _geometry.add(data);
+  mesh.bounds = data.bounds;
+  mesh.uploadTicket = _assets->flushUploads();
+
+  _loadedMeshes.push_back(mesh);
+}
+
+// each texture is uploaded and flushed as soon as it is decoded,
+// materials and instances refer to it by its request order
+void Renderer::uploadTextures() {
+  uint32_t id;
+  TextureData texture;
+  while (_textureLoader.next(&id, &texture)) {
+    ImageHandle image = uploadTexture(texture);
+    if (id >= _textures.size()) {
+      _textures.resize(id + 1);
+    }
+    _textures[id] = image;
+    _assets->writeTextureDescriptor(id, image);
+    _uploadTicket = _assets->flushUploads();
+  }
+}
 
-  _imageIndex = _assets->createImage(
-      texWidth, 
-      texHeight, 
-      vk::Format::eR8G8B8A8Srgb, 
+ImageHandle Renderer::uploadTexture(const TextureData& texture) {
+  uint32_t mipLevels = myUtils::mipLevelCount(texture.width, texture.height);
+
+  ImageHandle image = _assets->createImage(
+      texture.width, 
+      texture.height, 
+      mipLevels, 
+      texture.format, 
       vk::ImageTiling::eOptimal, 
-      vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled, 
+      vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled, 
       vk::MemoryPropertyFlagBits::eDeviceLocal
       );
 
-  transitionImageLayout(_assets->getImage(_imageIndex.value()), vk::Format::eR8G8B8A8Srgb, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal);
-  _assets->storeBufferToImage(stagingBuffer, _imageIndex.value(), texWidth, texHeight);
-  transitionImageLayout(_assets->getImage(_imageIndex.value()), vk::Format::eR8G8B8A8Srgb, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal);
-
-  _device.destroyBuffer(stagingBuffer);
-  _device.freeMemory(stagingMemory);
-}
-
-void Renderer::transitionImageLayout(vk::Image image, vk::Format format, vk::ImageLayout oldLayout, vk::ImageLayout newLayout) {
-  vk::CommandBuffer commandBuffer = myUtils::beginSingleTimeCommands(_device, _instance->getCommandPool());
-    vk::ImageMemoryBarrier barrier;
-    barrier.setOldLayout(oldLayout)
-           .setNewLayout(newLayout)
-           .setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
-           .setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
-           .setImage(image)
-           .setSubresourceRange(vk::ImageSubresourceRange(
-                 vk::ImageAspectFlagBits::eColor, 
-                 0, 1, 0, 1
-                 ));
-
-    vk::PipelineStageFlags sourceStage, dstStage;
-
-    if (oldLayout == vk::ImageLayout::eUndefined && newLayout == vk::ImageLayout::eTransferDstOptimal) {
-      barrier.setSrcAccessMask(vk::AccessFlags(0))
-             .setDstAccessMask(vk::AccessFlagBits::eTransferWrite);
-      sourceStage = vk::PipelineStageFlagBits::eTopOfPipe;
-      dstStage = vk::PipelineStageFlagBits::eTransfer;
-    } else if (oldLayout == vk::ImageLayout::eTransferDstOptimal && newLayout == vk::ImageLayout::eShaderReadOnlyOptimal) {
-      barrier.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite)
-             .setDstAccessMask(vk::AccessFlagBits::eShaderRead);
-      sourceStage = vk::PipelineStageFlagBits::eTransfer;
-      dstStage = vk::PipelineStageFlagBits::eFragmentShader;
-    } else {
-      throw std::runtime_error("unsupported old/newLayout transfer...");
+  _assets->transitionImageLayout(image, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal);
+
+  uint32_t mipWidth = texture.width;
+  uint32_t mipHeight = texture.height;
+  for (uint32_t i = 0; i < texture.levels.size(); i++) {
+    StagingAllocation staging = _assets->allocateStaging(texture.levels[i].size());
+    memcpy(staging.data, texture.levels[i].data(), texture.levels[i].size());
+    _assets->storeBufferToImage(staging, image, mipWidth, mipHeight, i);
+
+    mipWidth = std::max(mipWidth / 2, 1u);
+    mipHeight = std::max(mipHeight / 2, 1u);
+  }
+
+  if (texture.levels.size() == mipLevels) {
+    _assets->transitionImageLayout(image, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal);
+  } else if (_assets->supportsMipmapBlit(texture.format)) {
+    _assets->generateMipmaps(image);
+  } else {
+    // no linear blits for this format, build the chain on the cpu and upload every level
+    std::vector<std::vector<uint8_t>> levels = myUtils::generateMipChain(texture.levels[0].data(), texture.width, texture.height, texture.channels);
+    for (uint32_t i = 0; i < levels.size(); i++) {
+      StagingAllocation staging = _assets->allocateStaging(levels[i].size());
+      memcpy(staging.data, levels[i].data(), levels[i].size());
+      _assets->storeBufferToImage(staging, image, mipWidth, mipHeight, i + 1);
+
+      mipWidth = std::max(mipWidth / 2, 1u);
+      mipHeight = std::max(mipHeight / 2, 1u);
     }
+    _assets->transitionImageLayout(image, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal);
+  }
 
-    commandBuffer.pipelineBarrier(
-        sourceStage, dstStage, 
-        vk::DependencyFlags(0), 
-        0, nullptr, 
-        0, nullptr, 
-        1, &barrier
-        );
+  _assets->createImageView(image, texture.components);
 
-    myUtils::submitSingleTimeCommands(commandBuffer, _instance->getGraphicsQueue(), _device, _instance->getCommandPool());
+  return image;
 }
 
-void Renderer::allocateVertexBuffer() {
-  vk::DeviceSize bufferSize = sizeof(Vertex) * vertices.size();
-  vk::Buffer stagingBuffer;
-  vk::DeviceMemory stagingMemory;
+void Renderer::uploadInstances() {
+  if (_instances.empty()) {
+    _instances.push_back(InstanceData::pack(glm::mat4(1.0f), glm::vec4(1.0f), 0));
+  }
 
-  std::tie(stagingBuffer, stagingMemory) = myUtils::createStagingBuffer(
-      bufferSize,
-      _device, 
-      _gpu
-      );
+  // the shader indexes the bindless array unchecked, textures that were never loaded fall back to the first one
+  for (auto& instance : _instances) {
+    if (instance.textureIndex >= _textures.size()) {
+      instance.textureIndex = 0;
+    }
+  }
 
-  _vertexIndex = _assets->createBuffer(
+  vk::DeviceSize bufferSize = sizeof(InstanceData) * _instances.size();
+  _instanceBuffer = _assets->createBuffer(
       bufferSize, 
-      vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eTransferDst, 
+      vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst, 
       vk::MemoryPropertyFlagBits::eDeviceLocal);
 
-  void* data;
-  IF_THROW(
-      _device.mapMemory(stagingMemory, 0, bufferSize, vk::MemoryMapFlags(0), &data) != vk::Result::eSuccess,
-      failed to map memory
-      );
-    memcpy(data, vertices.data(), bufferSize);
-  _device.unmapMemory(stagingMemory);
+  _assets->uploadBuffer(_instanceBuffer, _instances.data(), bufferSize);
+  _instanceTicket = _assets->flushUploads();
+}
 
-  _assets->storeBuffer(stagingBuffer, _vertexIndex.value(), bufferSize);
+// built for every mesh loaded so far, the block count is kept so the counts stay where
+// the buffer has room for them while more blocks are added
+void Renderer::allocateMeshBuffers(MeshBuffers* buffers) {
+  buffers->meshes = _loadedMeshes;
+  buffers->blockCount = _geometry.getBlockCount();
 
-  _device.destroyBuffer(stagingBuffer);
-  _device.freeMemory(stagingMemory);
+  allocateIndirectBuffer(buffers);
+  if (_drawMode == DrawMode::eIndirect && _frustumCulling) {
+    allocateCullBuffers(buffers);
+  }
 }
 
-void Renderer::allocateIndexBuffer() {
-  vk::DeviceSize bufferSize = sizeof(uint16_t) * indices.size();
-  vk::Buffer stagingBuffer;
-  vk::DeviceMemory stagingMemory;
-
-  std::tie(stagingBuffer, stagingMemory) = myUtils::createStagingBuffer(
-      bufferSize,
-      _device, 
-      _gpu
+// at least one slot, a zero sized buffer is invalid and no mesh may have arrived yet
+void Renderer::allocateIndirectBuffer(MeshBuffers* buffers) {
+  uint32_t framesInFlight = _instance->getFramesInFlight();
+  vk::DeviceSize bufferSize = std::max<vk::DeviceSize>(
+      sizeof(vk::DrawIndexedIndirectCommand) * buffers->meshes.size() * framesInFlight + 
+      sizeof(uint32_t) * buffers->blockCount * framesInFlight, 
+      sizeof(vk::DrawIndexedIndirectCommand)
       );
 
-  _indexIndex = _assets->createBuffer(
+  buffers->indirectBuffer = _assets->createBuffer(
       bufferSize, 
-      vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eTransferDst, 
+      vk::BufferUsageFlagBits::eIndirectBuffer | vk::BufferUsageFlagBits::eStorageBuffer, 
+      vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+
+  _assets->mapMemory(buffers->indirectBuffer, bufferSize, &buffers->indirectData);
+}
+
+void Renderer::allocateCullBuffers(MeshBuffers* buffers) {
+  std::vector<glm::vec4> bounds;
+  for (const auto& mesh : buffers->meshes) {
+    bounds.push_back(mesh.bounds);
+  }
+
+  // room for at least one mesh, like the indirect buffer
+  vk::DeviceSize boundsSize = sizeof(glm::vec4) * bounds.size();
+  buffers->boundsBuffer = _assets->createBuffer(
+      std::max<vk::DeviceSize>(boundsSize, sizeof(glm::vec4)), 
+      vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst, 
       vk::MemoryPropertyFlagBits::eDeviceLocal);
 
-  void* data;
-  IF_THROW(
-      _device.mapMemory(stagingMemory, 0, bufferSize, vk::MemoryMapFlags(0), &data) != vk::Result::eSuccess,
-      failed to map memory
-      );
-    memcpy(data, indices.data(), bufferSize);
-  _device.unmapMemory(stagingMemory);
+  _assets->uploadBuffer(buffers->boundsBuffer, bounds.data(), boundsSize);
+  buffers->boundsTicket = _assets->flushUploads();
 
-  _assets->storeBuffer(stagingBuffer, _indexIndex.value(), bufferSize);
+  buffers->visibleInstanceBuffer = _assets->createBuffer(
+      sizeof(InstanceData) * _instances.size() * std::max<size_t>(buffers->meshes.size(), 1), 
+      vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eStorageBuffer, 
+      vk::MemoryPropertyFlagBits::eDeviceLocal);
+}
 
-  _device.destroyBuffer(stagingBuffer);
-  _device.freeMemory(stagingMemory);
+void Renderer::destroyMeshBuffers(const MeshBuffers& buffers) {
+  _assets->destroyBuffer(buffers.indirectBuffer);
+  if (_drawMode == DrawMode::eIndirect && _frustumCulling) {
+    _assets->destroyBuffer(buffers.boundsBuffer);
+    _assets->destroyBuffer(buffers.visibleInstanceBuffer);
+  }
 }
 
-void Renderer::allocateUniformBuffer() {
-  vk::DeviceSize bufferSize = sizeof(UniformBufferObject) * MAX_FRAMES_IN_FLIGHT;
+// the old buffers are retired, frames in flight keep drawing from them until they finish
+void Renderer::swapMeshBuffers() {
+  destroyMeshBuffers(_meshBuffers);
+  _meshBuffers = std::move(_pendingMeshBuffers);
+  _pendingMeshBuffers = MeshBuffers();
+  _hasPendingMeshBuffers = false;
+  updateCullDescriptorSets();
+}
 
-  _uniformIndex = _assets->createBuffer(
-      bufferSize, 
-      vk::BufferUsageFlagBits::eUniformBuffer,
-      vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+void Renderer::updateCullDescriptorSets() {
+  if (_drawMode != DrawMode::eIndirect || !_frustumCulling) return;
 
-  _assets->mapMemory(_uniformIndex.value(), bufferSize, &_data);
+  _assets->updateCullDescriptorSets(
+      _uniformRing.getBuffer(), 
+      _instanceBuffer, 
+      _meshBuffers.boundsBuffer, 
+      _meshBuffers.indirectBuffer, 
+      _meshBuffers.visibleInstanceBuffer
+      );
+}
+
+void Renderer::allocateUniformBuffer() {
+  _uniformRing.init(_assets, _gpu, UNIFORM_RING_FRAME_SIZE, _instance->getFramesInFlight());
 }
 
-void Renderer::updateUniformBuffer(uint32_t currentFrame) {
+// returns the dynamic offset the frame's uniforms were written to
+uint32_t Renderer::updateUniformBuffer() {
   static auto startTime = std::chrono::high_resolution_clock::now();
   auto currentTime = std::chrono::high_resolution_clock::now();
 
   vk::Extent2D swapChainExtent = _instance->getSwapChainExtent();
 
   float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
+  _model = glm::rotate(glm::mat4(1.0f), time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+
   UniformBufferObject ubo{};
-  ubo.model = glm::rotate(glm::mat4(1.0f), time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
   ubo.view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
   ubo.proj = glm::perspective(glm::radians(45.0f), swapChainExtent.width / (float) swapChainExtent.height, 0.1f, 10.0f);
   ubo.proj[1][1] *= -1;
-  memcpy((void*)((UniformBufferObject*)_data + currentFrame), &ubo, sizeof(ubo));
+  return _uniformRing.push(ubo);
+}
+
+// nothing is inherited by secondary buffers, every one of them starts with this
+void Renderer::bindDrawState(vk::CommandBuffer commandBuffer, uint32_t currentFrame, bool culled) {
+  commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, _assets->getGraphicsPipeline());
+
+  vk::Extent2D swapChainExtent = _instance->getSwapChainExtent();
+
+  vk::Viewport viewport;
+  viewport.setX(0.0f);
+  viewport.setY(0.0f);
+  viewport.setWidth(static_cast<float>(swapChainExtent.width));
+  viewport.setHeight(static_cast<float>(swapChainExtent.height));
+  viewport.setMinDepth(0.0f);
+  viewport.setMaxDepth(1.0f);
+
+  commandBuffer.setViewport(0, 1, &viewport);
+
+  vk::Rect2D scissor;
+  scissor.setOffset(vk::Offset2D(0, 0));
+  scissor.setExtent(swapChainExtent);
+
+  commandBuffer.setScissor(0, 1, &scissor);
+
+  // set 1 holds every texture, draws pick theirs by index
+  std::array<vk::DescriptorSet, 2> descriptorSets = {
+    _assets->getDescriptorSet()[currentFrame], 
+    _assets->getTextureDescriptorSet()
+  };
+  commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, _assets->getGraphicsPipelineLayout(), 0, descriptorSets.size(), descriptorSets.data(), 1, &_viewUniformOffset);
+
+  vk::Buffer instanceBuffer = _assets->getBuffer(culled ? _meshBuffers.visibleInstanceBuffer : _instanceBuffer);
+  vk::DeviceSize instanceOffset = 0;
+  commandBuffer.bindVertexBuffers(1, 1, &instanceBuffer, &instanceOffset);
+}
+
+void Renderer::bindGeometryBlock(vk::CommandBuffer commandBuffer, uint32_t block) {
+  vk::Buffer vertexBuffer = _geometry.getVertexBuffer(block);
+  vk::DeviceSize offset = 0;
+
+  commandBuffer.bindVertexBuffers(0, 1, &vertexBuffer, &offset);
+  commandBuffer.bindIndexBuffer(_geometry.getIndexBuffer(block), 0, _geometry.getIndexType(block));
+}
+
+void Renderer::pushDrawConstants(vk::CommandBuffer commandBuffer, uint32_t materialIndex) {
+  DrawPushConstants constants;
+  constants.model = _model;
+  constants.materialIndex = materialIndex;
+
+  commandBuffer.pushConstants(
+      _assets->getGraphicsPipelineLayout(), 
+      vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment, 
+      0, sizeof(constants), &constants
+      );
+}
+
+// meshes [firstMesh, endMesh)
+void Renderer::recordDirectDraws(vk::CommandBuffer commandBuffer, uint32_t instanceCount, uint32_t firstMesh, uint32_t endMesh) {
+  uint32_t boundBlock = UINT32_MAX;
+  for (uint32_t i = firstMesh; i < endMesh; i++) {
+    const Mesh& mesh = _meshBuffers.meshes[i];
+    if (!_assets->isUploadReady(mesh.uploadTicket)) continue;
+
+    if (mesh.geometry.block != boundBlock) {
+      bindGeometryBlock(commandBuffer, mesh.geometry.block);
+      boundBlock = mesh.geometry.block;
+    }
+    pushDrawConstants(commandBuffer, mesh.materialIndex);
+    commandBuffer.drawIndexed(mesh.geometry.indexCount, instanceCount, mesh.geometry.firstIndex, mesh.geometry.vertexOffset, 0);
+  }
+}
+
+// the meshes are split into consecutive chunks, each one recorded on a pool thread
+// meshes are sorted by geometry block, so a chunk only rebinds where the blocks change
+void Renderer::recordParallelDraws(vk::CommandBuffer commandBuffer, uint32_t currentFrame, uint32_t imageIndex, uint32_t instanceCount) {
+  vk::CommandBufferInheritanceInfo inheritance;
+  inheritance.setRenderPass(_instance->getRenderPass())
+             .setSubpass(0)
+             .setFramebuffer(_instance->getFramebuffer(imageIndex));
+
+  std::vector<vk::CommandBuffer> secondaryBuffers = _recorder.record(
+      static_cast<uint32_t>(_meshBuffers.meshes.size()), 
+      inheritance, 
+      [this, currentFrame, instanceCount](vk::CommandBuffer buffer, uint32_t firstMesh, uint32_t endMesh) {
+        bindDrawState(buffer, currentFrame, false);
+        recordDirectDraws(buffer, instanceCount, firstMesh, endMesh);
+      });
+
+  if (!secondaryBuffers.empty()) {
+    commandBuffer.executeCommands(secondaryBuffers);
+  }
+}
+
+// every mesh gets a command with no instances, cull.comp counts up the visible ones
+// and copies them to the mesh's range of the visible instance buffer
+void Renderer::recordCulling(vk::CommandBuffer commandBuffer, uint32_t currentFrame, uint32_t instanceCount) {
+  const uint32_t meshCount = static_cast<uint32_t>(_meshBuffers.meshes.size());
+  vk::DeviceSize commandsOffset = getIndirectCommandsOffset(currentFrame);
+  bool firstInstance = _instance->getEnabledFeatures().drawIndirectFirstInstance;
+
+  auto* commands = reinterpret_cast<vk::DrawIndexedIndirectCommand*>(static_cast<char*>(_meshBuffers.indirectData) + commandsOffset);
+  for (uint32_t i = 0; i < meshCount; i++) {
+    const Mesh& mesh = _meshBuffers.meshes[i];
+    // a mesh still uploading draws nothing
+    uint32_t indexCount = _assets->isUploadReady(mesh.uploadTicket) ? mesh.geometry.indexCount : 0;
+    commands[i] = vk::DrawIndexedIndirectCommand(
+        indexCount, 
+        0, 
+        mesh.geometry.firstIndex, 
+        mesh.geometry.vertexOffset, 
+        firstInstance ? i * instanceCount : 0
+        );
+  }
+
+  // the previous frame may still be reading the visible instances
+  commandBuffer.pipelineBarrier(
+      vk::PipelineStageFlagBits::eVertexInput, 
+      vk::PipelineStageFlagBits::eComputeShader, 
+      vk::DependencyFlags(0), 
+      0, nullptr, 
+      0, nullptr, 
+      0, nullptr
+      );
+
+  CullPushConstants constants;
+  constants.model = _model;
+  constants.instanceCount = instanceCount;
+  constants.meshCount = meshCount;
+  constants.commandBase = static_cast<uint32_t>(commandsOffset / sizeof(uint32_t));
+
+  commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, _assets->getCullPipeline());
+  commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, _assets->getCullPipelineLayout(), 0, 1, &_assets->getCullDescriptorSet()[currentFrame], 1, &_viewUniformOffset);
+  commandBuffer.pushConstants(_assets->getCullPipelineLayout(), vk::ShaderStageFlagBits::eCompute, 0, sizeof(constants), &constants);
+  commandBuffer.dispatch((instanceCount + 63) / 64, meshCount, 1);
+
+  vk::MemoryBarrier barrier;
+  barrier.setSrcAccessMask(vk::AccessFlagBits::eShaderWrite)
+         .setDstAccessMask(vk::AccessFlagBits::eIndirectCommandRead | vk::AccessFlagBits::eVertexAttributeRead);
+
+  commandBuffer.pipelineBarrier(
+      vk::PipelineStageFlagBits::eComputeShader, 
+      vk::PipelineStageFlagBits::eDrawIndirect | vk::PipelineStageFlagBits::eVertexInput, 
+      vk::DependencyFlags(0), 
+      1, &barrier, 
+      0, nullptr, 
+      0, nullptr
+      );
+}
+
+// the commands of a block are packed from the slot of its first mesh, meshes still uploading are left out
+// with VK_KHR_draw_indirect_count the gpu reads how many there are, otherwise the cpu passes the count
+void Renderer::recordIndirectDraws(vk::CommandBuffer commandBuffer, uint32_t currentFrame, uint32_t instanceCount, bool culled) {
+  const uint32_t meshCount = static_cast<uint32_t>(_meshBuffers.meshes.size());
+  const uint32_t blockCount = _meshBuffers.blockCount;
+  const uint32_t stride = sizeof(vk::DrawIndexedIndirectCommand);
+
+  vk::DeviceSize commandsOffset = getIndirectCommandsOffset(currentFrame);
+  vk::DeviceSize countsOffset = getIndirectCountsOffset(currentFrame);
+
+  auto* commands = reinterpret_cast<vk::DrawIndexedIndirectCommand*>(static_cast<char*>(_meshBuffers.indirectData) + commandsOffset);
+  auto* counts = reinterpret_cast<uint32_t*>(static_cast<char*>(_meshBuffers.indirectData) + countsOffset);
+
+  // one push for all of them, a per draw material would need gl_DrawID
+  pushDrawConstants(commandBuffer, 0);
+
+  vk::Buffer indirectBuffer = _assets->getBuffer(_meshBuffers.indirectBuffer);
+  PFN_vkCmdDrawIndexedIndirectCountKHR drawIndexedIndirectCount = _instance->getDrawIndexedIndirectCount();
+  bool multiDrawIndirect = _instance->getEnabledFeatures().multiDrawIndirect;
+  // without drawIndirectFirstInstance every culled mesh's range of the visible instances is bound on its own
+  bool perMeshInstances = culled && !_instance->getEnabledFeatures().drawIndirectFirstInstance;
+
+  uint32_t next = 0;
+  for (uint32_t block = 0; block < blockCount; block++) {
+    uint32_t first = next;
+    uint32_t count = 0;
+    for (; next < meshCount && _meshBuffers.meshes[next].geometry.block == block; next++) {
+      // recordCulling() already wrote a command for every mesh
+      if (culled) {
+        count++;
+        continue;
+      }
+
+      const Mesh& mesh = _meshBuffers.meshes[next];
+      if (!_assets->isUploadReady(mesh.uploadTicket)) continue;
+
+      commands[first + count] = vk::DrawIndexedIndirectCommand(
+          mesh.geometry.indexCount, 
+          instanceCount, 
+          mesh.geometry.firstIndex, 
+          mesh.geometry.vertexOffset, 
+          0
+          );
+      count++;
+    }
+    if (count == 0) continue;
+
+    bindGeometryBlock(commandBuffer, block);
+
+    vk::DeviceSize offset = commandsOffset + static_cast<vk::DeviceSize>(stride) * first;
+    if (perMeshInstances) {
+      vk::Buffer visibleBuffer = _assets->getBuffer(_meshBuffers.visibleInstanceBuffer);
+      for (uint32_t i = 0; i < count; i++) {
+        vk::DeviceSize instanceOffset = sizeof(InstanceData) * instanceCount * (first + i);
+        commandBuffer.bindVertexBuffers(1, 1, &visibleBuffer, &instanceOffset);
+        commandBuffer.drawIndexedIndirect(indirectBuffer, offset + stride * i, 1, stride);
+      }
+    } else if (drawIndexedIndirectCount) {
+      counts[block] = count;
+      drawIndexedIndirectCount(
+          static_cast<VkCommandBuffer>(commandBuffer), 
+          static_cast<VkBuffer>(indirectBuffer), offset, 
+          static_cast<VkBuffer>(indirectBuffer), countsOffset + sizeof(uint32_t) * block, 
+          next - first, stride
+          );
+    } else if (multiDrawIndirect) {
+      commandBuffer.drawIndexedIndirect(indirectBuffer, offset, count, stride);
+    } else {
+      for (uint32_t i = 0; i < count; i++) {
+        commandBuffer.drawIndexedIndirect(indirectBuffer, offset + stride * i, 1, stride);
+      }
+    }
+  }
+}
+
+vk::DeviceSize Renderer::getIndirectCommandsOffset(uint32_t frame) const {
+  return sizeof(vk::DrawIndexedIndirectCommand) * _meshBuffers.meshes.size() * frame;
+}
+
+vk::DeviceSize Renderer::getIndirectCountsOffset(uint32_t frame) const {
+  return 
+    sizeof(vk::DrawIndexedIndirectCommand) * _meshBuffers.meshes.size() * _instance->getFramesInFlight() + 
+    sizeof(uint32_t) * _meshBuffers.blockCount * frame;
 }
@@ -28,6 +28,18 @@ namespace myUtils {
     return buffer;
   }
 
+  void writeBinaryFile(const std::string& filename, const std::vector<char>& data) {
+    std::ofstream file(filename, std::ios::trunc | std::ios::binary);
+
+    if (!file.is_open()) {
+      throw std::runtime_error("failed to open: " + filename);
+    }
+
+    file.write(data.data(), data.size());
+
+    file.close();
+  }
+
   bool validationLayerSupportChecked(const std::vector<const char*> validationLayers) {
     std::vector<vk::LayerProperties> availableLayers = vk::enumerateInstanceLayerProperties();
 
@@ -52,6 +64,19 @@ namespace myUtils {
     return requiredDeviceExtensions.empty();
   }
 
+  bool descriptorIndexingSupportChecked(vk::PhysicalDevice device) {
+    if (device.getProperties().apiVersion < VK_API_VERSION_1_1) return false;
+    if (!deviceExtensionSupportChecked(device, { VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME })) return false;
+
+    auto features = device.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceDescriptorIndexingFeatures>();
+    const auto& indexing = features.get<vk::PhysicalDeviceDescriptorIndexingFeatures>();
+    return indexing.shaderSampledImageArrayNonUniformIndexing
+        && indexing.descriptorBindingSampledImageUpdateAfterBind
+        && indexing.descriptorBindingPartiallyBound
+        && indexing.descriptorBindingUpdateUnusedWhilePending
+        && indexing.runtimeDescriptorArray;
+  }
+
   QueueFamilyIndices* findQueueFamilies(vk::PhysicalDevice device, vk::SurfaceKHR surface) {
     QueueFamilyIndices* indices = new QueueFamilyIndices;
 
@@ -59,13 +84,25 @@ namespace myUtils {
 
     int i = 0;
     for (const auto& queueFamily : queueFamilies) {
-      if (device.getSurfaceSupportKHR(i, surface)) {
-        indices->presentFamily = i;
+      if (!indices->isComplete()) {
+        if (surface && device.getSurfaceSupportKHR(i, surface)) {
+          indices->presentFamily = i;
+        }
+        if (queueFamily.queueFlags & vk::QueueFlagBits::eGraphics) {
+          indices->graphicsFamily = i;
+          // headless, nothing to present so the graphics queue stands in
+          if (!surface) {
+            indices->presentFamily = i;
+          }
+        }
       }
-      if (queueFamily.queueFlags & vk::QueueFlagBits::eGraphics) {
-        indices->graphicsFamily = i;
+      // prefer a pure copy engine over an async compute family
+      bool asyncTransfer = (queueFamily.queueFlags & vk::QueueFlagBits::eTransfer) 
+                        && !(queueFamily.queueFlags & vk::QueueFlagBits::eGraphics);
+      bool transferOnly = asyncTransfer && !(queueFamily.queueFlags & vk::QueueFlagBits::eCompute);
+      if (asyncTransfer && (!indices->transferFamily.has_value() || transferOnly)) {
+        indices->transferFamily = i;
       }
-      if (indices->isComplete()) break;
       i++;
     }
 
@@ -85,9 +122,11 @@ namespace myUtils {
 
     bool extensionSupported = deviceExtensionSupportChecked(phyDevice, deviceExtensions);
 
-    bool swapChainAdequate = false;
+    bool descriptorIndexing = descriptorIndexingSupportChecked(phyDevice);
+
+    bool swapChainAdequate = !surface;
 
-    if (extensionSupported) {
+    if (extensionSupported && surface) {
       SwapChainSupportDetails swapChainSupport = querySwapChainSupport(phyDevice, surface);
       swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
     }
@@ -95,17 +134,18 @@ namespace myUtils {
     // i would not check SamplerAnisotropy feature here cause i'm too lazy
     if (indices->isComplete() 
         && extensionSupported 
+        && descriptorIndexing 
         && swapChainAdequate) 
       return std::tuple<bool, QueueFamilyIndices*>(true, indices);
     delete indices;
     return std::tuple<bool, QueueFamilyIndices*>(false, nullptr);
   }
 
-  vk::ShaderModule createShaderModule(vk::Device device, const std::vector<char>& code) {
+  vk::ShaderModule createShaderModule(vk::Device device, const uint32_t* code, size_t wordCount) {
     vk::ShaderModule shaderModule;
     vk::ShaderModuleCreateInfo createInfo;
-    createInfo.setCodeSize(code.size());
-    createInfo.setPCode(reinterpret_cast<const uint32_t*>(code.data()));
+    createInfo.setCodeSize(wordCount * sizeof(uint32_t));
+    createInfo.setPCode(code);
 
     shaderModule = device.createShaderModule(createInfo);
     return shaderModule;
@@ -159,72 +199,15 @@ namespace myUtils {
   }
 
 
-  std::tuple<vk::Buffer, vk::DeviceMemory> createStagingBuffer(
-      vk::DeviceSize bufferSize, 
-      vk::Device device, 
-      vk::PhysicalDevice physicalDevice) {
-    vk::Buffer buffer;
-    vk::DeviceMemory memory;
-
-    vk::BufferCreateInfo bufferInfo;
-    bufferInfo.setSize(bufferSize)
-              .setUsage(vk::BufferUsageFlagBits::eTransferSrc)
-              .setSharingMode(vk::SharingMode::eExclusive);
-
-    buffer = device.createBuffer(bufferInfo);
-
-    vk::MemoryRequirements memRequirement = device.getBufferMemoryRequirements(buffer);
-
-    vk::MemoryAllocateInfo memoryInfo;
-    memoryInfo.setAllocationSize(memRequirement.size)
-              .setMemoryTypeIndex(findMemType(
-                    memRequirement.memoryTypeBits, 
-                    vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, 
-                    physicalDevice));
-
-    memory = device.allocateMemory(memoryInfo);
-
-    device.bindBufferMemory(buffer, memory, 0);
-
-    return std::tuple(buffer, memory);
-  }
-
-  vk::CommandBuffer beginSingleTimeCommands(vk::Device device, vk::CommandPool commandPool) {
-    vk::CommandBufferAllocateInfo allocInfo;
-    allocInfo.setLevel(vk::CommandBufferLevel::ePrimary)
-             .setCommandPool(commandPool)
-             .setCommandBufferCount(1);
-
-    vk::CommandBuffer cmdBuffer = device.allocateCommandBuffers(allocInfo)[0];
-
-    vk::CommandBufferBeginInfo beginInfo;
-    beginInfo.setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
-
-    cmdBuffer.begin(beginInfo);
-
-    return cmdBuffer;
-  }
-
-  void submitSingleTimeCommands(vk::CommandBuffer commandBuffer, vk::Queue queue, vk::Device device, vk::CommandPool commandPool) {
-    commandBuffer.end();
-
-    vk::SubmitInfo submitInfo;
-    submitInfo.setCommandBuffers(commandBuffer);
-
-    queue.submit(submitInfo);
-    queue.waitIdle();
-
-    device.freeCommandBuffers(commandPool, 1, &commandBuffer);
-  }
-
-  vk::ImageView createImageView(vk::Image image, vk::Format format, vk::Device device) {
+  vk::ImageView createImageView(vk::Image image, vk::Format format, vk::Device device, uint32_t mipLevels, vk::ComponentMapping components) {
     vk::ImageViewCreateInfo createInfo;
     createInfo.setImage(image)
               .setViewType(vk::ImageViewType::e2D)
               .setFormat(format)
+              .setComponents(components)
               .setSubresourceRange(vk::ImageSubresourceRange(
                     vk::ImageAspectFlagBits::eColor, 
-                    0, 1, 0, 1
+                    0, mipLevels, 0, 1
                     ));
 
     vk::ImageView imageView = device.createImageView(createInfo);
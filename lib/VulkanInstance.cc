@@ -3,6 +3,7 @@
 #include <iostream>
 #include <stdexcept>
 #include <cstdlib>
+#include <cstring>
 #include <vector>
 #include <set>
 #include <limits>
@@ -30,22 +31,30 @@ VulkanInstance::~VulkanInstance() {
 
 void VulkanInstance::init() {
   createInstance();
-  createSurface();
+  if (!_headless) {
+    createSurface();
+  }
   pickPhysicalDevice();
   createLogicalDevice();
-  createSwapChain();
+  if (_headless) {
+    createOffscreenImages();
+  } else {
+    createSwapChain();
+  }
   createImageViews();
   createRenderPass();
   createFrameBuffers();
   createCommandPool();
   allocateCommandBuffers();
   createSyncObjects();
+  createTimestampQueryPool();
 }
 
 void VulkanInstance::cleanup() {
   cleanupSwapChain();
   cleanupRenderPass();
   cleanupSyncObjects();
+  cleanupTimestampQueryPool();
   cleanupCommandPool();
   cleanupLogicalDevice();
   cleanupSurface();
@@ -53,13 +62,44 @@ void VulkanInstance::cleanup() {
 }
 
 void VulkanInstance::currentFrameInc() {
-  _currentFrame = (_currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+  _currentFrame = (_currentFrame + 1) % _framesInFlight;
+  _frameCount++;
 }
 
 void VulkanInstance::setWindow(GLFWwindow* w) {
   _window = w;
 }
 
+// render into a ring of offscreen color images instead of a swapchain,
+// must be called before init(), no window or surface is needed
+void VulkanInstance::setHeadless(uint32_t width, uint32_t height) {
+  _headless = true;
+  _swapChainExtent = vk::Extent2D(width, height);
+}
+
+// trades latency for throughput, must be called before init()
+void VulkanInstance::setFramesInFlight(uint32_t count) {
+  IF_THROW(
+      count < 1 || count > MAX_FRAMES_IN_FLIGHT,
+      frames in flight must be between 1 and MAX_FRAMES_IN_FLIGHT
+      );
+  _framesInFlight = count;
+}
+
+void VulkanInstance::setEnableValidationLayers(bool v) {
+  _enableValidationLayers = v;
+}
+
+// uploads go through the graphics queue when disabled or when the gpu has no separate transfer family
+void VulkanInstance::setEnableTransferQueue(bool v) {
+  _enableTransferQueue = v;
+}
+
+// must be called before init()
+void VulkanInstance::setCommandResetMode(CommandResetMode mode) {
+  _commandResetMode = mode;
+}
+
 void VulkanInstance::setFrameBufferResized(bool v) {
   _frameBufferResized = v;
 }
@@ -80,6 +120,12 @@ void VulkanInstance::recreateSwapChain() {
 }
 
 uint32_t VulkanInstance::acquireImage() {
+  // one offscreen image per frame in flight, so the image of the current frame
+  // is free again once its fence has been waited
+  if (_headless) {
+    return _currentFrame;
+  }
+
   uint32_t imageIndex;
   auto acquireResult = _device.acquireNextImageKHR(_swapChain, UINT64_MAX, _imageAvailableSemaphores[_currentFrame], nullptr, &imageIndex);
   if (acquireResult == vk::Result::eErrorOutOfDateKHR) {
@@ -95,6 +141,27 @@ uint32_t VulkanInstance::getCurrentFrame() const {
   return _currentFrame;
 }
 
+// frames submitted so far, unlike getCurrentFrame() it never wraps
+uint64_t VulkanInstance::getFrameCount() const {
+  return _frameCount;
+}
+
+uint32_t VulkanInstance::getFramesInFlight() const {
+  return _framesInFlight;
+}
+
+bool VulkanInstance::isHeadless() const {
+  return _headless;
+}
+
+const vk::PhysicalDeviceFeatures& VulkanInstance::getEnabledFeatures() const {
+  return _enabledFeatures;
+}
+
+PFN_vkCmdDrawIndexedIndirectCountKHR VulkanInstance::getDrawIndexedIndirectCount() const {
+  return _drawIndexedIndirectCount;
+}
+
 vk::PhysicalDevice VulkanInstance::getGPU() const {
   return _gpu;
 }
@@ -107,6 +174,21 @@ vk::Queue VulkanInstance::getGraphicsQueue() const {
   return _graphicsQueue;
 }
 
+uint32_t VulkanInstance::getGraphicsQueueFamily() const {
+  return _queueIndices->graphicsFamily.value();
+}
+
+vk::Queue VulkanInstance::getTransferQueue() const {
+  return _transferQueue;
+}
+
+uint32_t VulkanInstance::getTransferQueueFamily() const {
+  if (_enableTransferQueue && _queueIndices->transferFamily.has_value()) {
+    return _queueIndices->transferFamily.value();
+  }
+  return _queueIndices->graphicsFamily.value();
+}
+
 vk::Queue VulkanInstance::getPresentQueue() const {
   return _presentQueue;
 }
@@ -139,6 +221,13 @@ vk::Fence VulkanInstance::getFence(uint32_t index) const {
   return _inFlightFences[index];
 }
 
+// durations of the passes recorded by the most recently resolved frame,
+// lags getFramesInFlight() frames behind since nothing waits on the gpu for it
+// empty when that frame's results were not available yet
+const std::vector<GpuPassTime>& VulkanInstance::getGpuPassTimes() const {
+  return _gpuPassTimes;
+}
+
 void VulkanInstance::waitForFence() const {
   vk::Result result;
   result = _device.waitForFences(1, &_inFlightFences[_currentFrame], VK_TRUE, UINT64_MAX);
@@ -153,14 +242,25 @@ void VulkanInstance::waitForFence() const {
       );
 }
 
-vk::CommandBuffer VulkanInstance::getCommandBufferBegin() const {
-  _commandBuffers[_currentFrame].reset();
+// call after waitForFence(), the frame's previous commands must have finished
+vk::CommandBuffer VulkanInstance::getCommandBufferBegin() {
   vk::CommandBufferBeginInfo beginInfo;
-  beginInfo.setFlags(vk::CommandBufferUsageFlags(0));
+  if (_commandResetMode == CommandResetMode::ePerFramePool) {
+    FrameCommands& frameCommands = _frameCommands[_currentFrame];
+    _device.resetCommandPool(frameCommands.pool);
+    frameCommands.next = 0;
+    _commandBuffers[_currentFrame] = nextFrameCommandBuffer();
+    beginInfo.setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
+  } else {
+    _commandBuffers[_currentFrame].reset();
+    beginInfo.setFlags(vk::CommandBufferUsageFlags(0));
+  }
   beginInfo.setPInheritanceInfo(nullptr);
 
   _commandBuffers[_currentFrame].begin(beginInfo);
 
+  resolveTimestamps(_commandBuffers[_currentFrame]);
+
   return _commandBuffers[_currentFrame];
 }
 
@@ -176,10 +276,13 @@ void VulkanInstance::applyGraphicsQueue() const {
   std::vector<vk::PipelineStageFlags> waitStages = { vk::PipelineStageFlagBits::eColorAttachmentOutput };
   std::vector<vk::Semaphore> signalSemaphores = { _renderFinishedSemaphores[_currentFrame] };
 
-  submitInfo.setWaitSemaphores(waitSemaphores);
-  submitInfo.setWaitDstStageMask(waitStages);
+  // nothing acquires or presents in headless mode, the fence is enough
+  if (!_headless) {
+    submitInfo.setWaitSemaphores(waitSemaphores);
+    submitInfo.setWaitDstStageMask(waitStages);
 
-  submitInfo.setSignalSemaphores(signalSemaphores);
+    submitInfo.setSignalSemaphores(signalSemaphores);
+  }
   
   submitInfo.setCommandBufferCount(1);
   submitInfo.setPCommandBuffers(&_commandBuffers[_currentFrame]);
@@ -192,6 +295,10 @@ void VulkanInstance::applyGraphicsQueue() const {
 }
 
 void VulkanInstance::applyPresentQueue(uint32_t imageIndex) {
+  if (_headless) {
+    return;
+  }
+
   vk::Result result;
   std::vector<vk::Semaphore> waitSemaphores = { _renderFinishedSemaphores[_currentFrame] };
 
@@ -213,6 +320,37 @@ void VulkanInstance::applyPresentQueue(uint32_t imageIndex) {
   }
 }
 
+// returns the pass id to hand to endTimestamp(), must be recorded outside of a render pass
+// when the queue does not support timestamps both calls do nothing
+uint32_t VulkanInstance::beginTimestamp(vk::CommandBuffer commandBuffer, const std::string& passName) {
+  if (!_timestampPool) {
+    return 0;
+  }
+
+  std::vector<std::string>& passNames = _timestampPassNames[_currentFrame];
+  IF_THROW(
+      passNames.size() >= MAX_GPU_TIMESTAMP_PASSES,
+      too many timestamp passes in one frame...
+      );
+
+  uint32_t pass = static_cast<uint32_t>(passNames.size());
+  passNames.push_back(passName);
+
+  uint32_t query = _currentFrame * MAX_GPU_TIMESTAMP_PASSES * 2 + pass * 2;
+  commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, _timestampPool, query);
+
+  return pass;
+}
+
+void VulkanInstance::endTimestamp(vk::CommandBuffer commandBuffer, uint32_t pass) {
+  if (!_timestampPool) {
+    return;
+  }
+
+  uint32_t query = _currentFrame * MAX_GPU_TIMESTAMP_PASSES * 2 + pass * 2 + 1;
+  commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, _timestampPool, query);
+}
+
 void VulkanInstance::createInstance() {
   IF_THROW(
       _enableValidationLayers && !myUtils::validationLayerSupportChecked(validationLayers),
@@ -224,18 +362,22 @@ void VulkanInstance::createInstance() {
          .setApplicationVersion(VK_MAKE_VERSION(1, 0, 0))
          .setPEngineName("No Engine")
          .setEngineVersion(VK_MAKE_VERSION(1, 0, 0))
-         .setApiVersion(VK_API_VERSION_1_0);
+         .setApiVersion(VK_API_VERSION_1_1);
 
   vk::InstanceCreateInfo createInfo;
   createInfo.setPApplicationInfo(&appInfo);
   
-  uint32_t glfwExtensionCount = 0;
-  const char** glfwExtensions;
-  
-  glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-  
-  createInfo.setEnabledExtensionCount(glfwExtensionCount);
-  createInfo.setPpEnabledExtensionNames(glfwExtensions);
+  std::vector<const char*> extensions;
+
+  if (!_headless) {
+    uint32_t glfwExtensionCount = 0;
+    const char** glfwExtensions;
+
+    glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+    extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+  }
+
+  createInfo.setPEnabledExtensionNames(extensions);
 
   if (_enableValidationLayers) {
     createInfo.setPEnabledLayerNames(validationLayers);
@@ -263,7 +405,7 @@ void VulkanInstance::pickPhysicalDevice() {
   for (const auto& phyDevice : phyDevices) {
     bool result;
     QueueFamilyIndices* indices;
-    std::tie(result, indices) = myUtils::isDeviceSuitable(phyDevice, _surface, deviceExtensions);
+    std::tie(result, indices) = myUtils::isDeviceSuitable(phyDevice, _surface, _headless ? std::vector<const char*>() : deviceExtensions);
     if (result) {
       _queueIndices = indices;
       _gpu = phyDevice;
@@ -275,7 +417,7 @@ void VulkanInstance::pickPhysicalDevice() {
 
 void VulkanInstance::createLogicalDevice() {
   std::vector<vk::DeviceQueueCreateInfo> queueCreateInfos;
-  std::set<uint32_t> uniqueQueueFamilies = { _queueIndices->graphicsFamily.value(), _queueIndices->presentFamily.value() };
+  std::set<uint32_t> uniqueQueueFamilies = { _queueIndices->graphicsFamily.value(), _queueIndices->presentFamily.value(), getTransferQueueFamily() };
 
   float queuePriority = 1.0f;
   for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -286,22 +428,58 @@ void VulkanInstance::createLogicalDevice() {
     queueCreateInfos.push_back(queueCreateInfo);
   }
 
-  vk::PhysicalDeviceFeatures deviceFeatures;
-  deviceFeatures.setSamplerAnisotropy(true);
+  _enabledFeatures = vk::PhysicalDeviceFeatures();
+  _enabledFeatures.setSamplerAnisotropy(true);
+  // optional, textures fall back to uncompressed formats without it
+  _enabledFeatures.setTextureCompressionBC(_gpu.getFeatures().textureCompressionBC);
+  // optional, indirect draws are issued one command at a time without it
+  _enabledFeatures.setMultiDrawIndirect(_gpu.getFeatures().multiDrawIndirect);
+  // optional, culled meshes are drawn one by one from their own range of the visible instances without it
+  _enabledFeatures.setDrawIndirectFirstInstance(_gpu.getFeatures().drawIndirectFirstInstance);
+
+  std::vector<const char*> enabledExtensions;
+  if (!_headless) {
+    enabledExtensions = deviceExtensions;
+  }
+  // required, checked in isDeviceSuitable, textures are sampled from one bindless array
+  enabledExtensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+
+  vk::PhysicalDeviceDescriptorIndexingFeatures indexingFeatures;
+  indexingFeatures.setShaderSampledImageArrayNonUniformIndexing(true)
+                  .setDescriptorBindingSampledImageUpdateAfterBind(true)
+                  .setDescriptorBindingPartiallyBound(true)
+                  .setDescriptorBindingUpdateUnusedWhilePending(true)
+                  .setRuntimeDescriptorArray(true);
+
+  // optional, lets the gpu read the number of indirect draws from a buffer
+  bool drawIndirectCount = false;
+  for (const auto& extension : _gpu.enumerateDeviceExtensionProperties()) {
+    if (strcmp(extension.extensionName, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME) == 0) {
+      drawIndirectCount = true;
+      enabledExtensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+    }
+  }
 
   vk::DeviceCreateInfo createInfo;
-  createInfo.setQueueCreateInfos(queueCreateInfos)
-            .setPEnabledFeatures(&deviceFeatures)
-            .setPEnabledExtensionNames(deviceExtensions)
+  createInfo.setPNext(&indexingFeatures)
+            .setQueueCreateInfos(queueCreateInfos)
+            .setPEnabledFeatures(&_enabledFeatures)
+            .setPEnabledExtensionNames(enabledExtensions)
             .setEnabledLayerCount(0);
 
   _device = _gpu.createDevice(createInfo);
   CHECK_NULL(_device);
 
+  if (drawIndirectCount) {
+    _drawIndexedIndirectCount = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(_device.getProcAddr("vkCmdDrawIndexedIndirectCountKHR"));
+  }
+
   _graphicsQueue = _device.getQueue(_queueIndices->graphicsFamily.value(), 0);
   CHECK_NULL(_graphicsQueue);
   _presentQueue = _device.getQueue(_queueIndices->presentFamily.value(), 0);
   CHECK_NULL(_presentQueue);
+  _transferQueue = _device.getQueue(getTransferQueueFamily(), 0);
+  CHECK_NULL(_transferQueue);
 }
 
 void VulkanInstance::createSwapChain() {
@@ -347,6 +525,58 @@ void VulkanInstance::createSwapChain() {
   _swapChainExtent = extent;
 }
 
+void VulkanInstance::createOffscreenImages() {
+  std::vector<vk::Format> candidates = { vk::Format::eB8G8R8A8Srgb, vk::Format::eR8G8B8A8Srgb };
+
+  _swapChainImageFormat = vk::Format::eUndefined;
+  for (const auto& format : candidates) {
+    vk::FormatProperties props = _gpu.getFormatProperties(format);
+    if (props.optimalTilingFeatures & vk::FormatFeatureFlagBits::eColorAttachment) {
+      _swapChainImageFormat = format;
+      break;
+    }
+  }
+  IF_THROW(
+      _swapChainImageFormat == vk::Format::eUndefined,
+      no offscreen color format supported...
+      );
+
+  _swapChainImages.resize(_framesInFlight);
+  _offscreenMemories.resize(_framesInFlight);
+
+  for (size_t i = 0; i < _framesInFlight; i++) {
+    vk::ImageCreateInfo createInfo;
+    createInfo.setImageType(vk::ImageType::e2D)
+              .setExtent(vk::Extent3D(_swapChainExtent, 1))
+              .setMipLevels(1)
+              .setArrayLayers(1)
+              .setFormat(_swapChainImageFormat)
+              .setTiling(vk::ImageTiling::eOptimal)
+              .setInitialLayout(vk::ImageLayout::eUndefined)
+              .setUsage(vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc)
+              .setSamples(vk::SampleCountFlagBits::e1)
+              .setSharingMode(vk::SharingMode::eExclusive);
+
+    _swapChainImages[i] = _device.createImage(createInfo);
+    CHECK_NULL(_swapChainImages[i]);
+
+    vk::MemoryRequirements memRequirements = _device.getImageMemoryRequirements(_swapChainImages[i]);
+
+    vk::MemoryAllocateInfo allocInfo;
+    allocInfo.setAllocationSize(memRequirements.size)
+             .setMemoryTypeIndex(myUtils::findMemType(
+                   memRequirements.memoryTypeBits, 
+                   vk::MemoryPropertyFlagBits::eDeviceLocal, 
+                   _gpu
+                   ));
+
+    _offscreenMemories[i] = _device.allocateMemory(allocInfo);
+    CHECK_NULL(_offscreenMemories[i]);
+
+    _device.bindImageMemory(_swapChainImages[i], _offscreenMemories[i], 0);
+  }
+}
+
 void VulkanInstance::createImageViews() {
   _swapChainImageViews.resize(_swapChainImages.size());
   for (size_t i = 0; i < _swapChainImages.size(); i++) {
@@ -364,7 +594,7 @@ void VulkanInstance::createRenderPass() {
   colorAttachment.setStencilLoadOp(vk::AttachmentLoadOp::eDontCare);
   colorAttachment.setStencilStoreOp(vk::AttachmentStoreOp::eDontCare);
   colorAttachment.setInitialLayout(vk::ImageLayout::eUndefined);
-  colorAttachment.setFinalLayout(vk::ImageLayout::ePresentSrcKHR);
+  colorAttachment.setFinalLayout(_headless ? vk::ImageLayout::eTransferSrcOptimal : vk::ImageLayout::ePresentSrcKHR);
 
   vk::AttachmentReference colorAttachmentRef;
   colorAttachmentRef.setAttachment(0);
@@ -412,10 +642,24 @@ void VulkanInstance::createCommandPool() {
   createInfo.setQueueFamilyIndex(_queueIndices->graphicsFamily.value());
 
   _commandPool = _device.createCommandPool(createInfo);
+
+  if (_commandResetMode != CommandResetMode::ePerFramePool) return;
+
+  vk::CommandPoolCreateInfo frameCreateInfo;
+  frameCreateInfo.setFlags(vk::CommandPoolCreateFlagBits::eTransient);
+  frameCreateInfo.setQueueFamilyIndex(_queueIndices->graphicsFamily.value());
+
+  _frameCommands.resize(_framesInFlight);
+  for (auto& frameCommands : _frameCommands) {
+    frameCommands.pool = _device.createCommandPool(frameCreateInfo);
+    CHECK_NULL(frameCommands.pool);
+  }
 }
 
+// per frame pools hand their buffers out in getCommandBufferBegin()
 void VulkanInstance::allocateCommandBuffers() {
-  _commandBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+  _commandBuffers.resize(_framesInFlight);
+  if (_commandResetMode == CommandResetMode::ePerFramePool) return;
   
   vk::CommandBufferAllocateInfo allocInfo;
   allocInfo.setCommandPool(_commandPool);
@@ -425,23 +669,93 @@ void VulkanInstance::allocateCommandBuffers() {
   _commandBuffers = _device.allocateCommandBuffers(allocInfo);
 }
 
+// the next unused buffer of the current frame's pool, allocated the first time it is needed
+vk::CommandBuffer VulkanInstance::nextFrameCommandBuffer() {
+  FrameCommands& frameCommands = _frameCommands[_currentFrame];
+  if (frameCommands.next == frameCommands.buffers.size()) {
+    vk::CommandBufferAllocateInfo allocInfo;
+    allocInfo.setCommandPool(frameCommands.pool);
+    allocInfo.setLevel(vk::CommandBufferLevel::ePrimary);
+    allocInfo.setCommandBufferCount(1);
+
+    frameCommands.buffers.push_back(_device.allocateCommandBuffers(allocInfo)[0]);
+  }
+  return frameCommands.buffers[frameCommands.next++];
+}
+
 void VulkanInstance::createSyncObjects() {
-  _imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-  _renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-  _inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
+  _imageAvailableSemaphores.resize(_framesInFlight);
+  _renderFinishedSemaphores.resize(_framesInFlight);
+  _inFlightFences.resize(_framesInFlight);
 
   vk::SemaphoreCreateInfo semaphoreInfo;
 
   vk::FenceCreateInfo fenceInfo;
   fenceInfo.setFlags(vk::FenceCreateFlagBits::eSignaled);
 
-  for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+  for (size_t i = 0; i < _framesInFlight; i++) {
     _imageAvailableSemaphores[i] = _device.createSemaphore(semaphoreInfo);
     _renderFinishedSemaphores[i] = _device.createSemaphore(semaphoreInfo);
     _inFlightFences[i] = _device.createFence(fenceInfo);
   }
 }
 
+void VulkanInstance::createTimestampQueryPool() {
+  _timestampPassNames.resize(_framesInFlight);
+
+  uint32_t validBits = _gpu.getQueueFamilyProperties()[_queueIndices->graphicsFamily.value()].timestampValidBits;
+  if (validBits == 0) {
+    return;
+  }
+
+  _timestampPeriod = _gpu.getProperties().limits.timestampPeriod;
+  _timestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+
+  // two queries (begin/end) per pass, one range of passes per frame in flight
+  vk::QueryPoolCreateInfo createInfo;
+  createInfo.setQueryType(vk::QueryType::eTimestamp)
+            .setQueryCount(MAX_GPU_TIMESTAMP_PASSES * 2 * _framesInFlight);
+
+  _timestampPool = _device.createQueryPool(createInfo);
+  CHECK_NULL(_timestampPool);
+}
+
+// the fence of the current frame has been waited, so the queries it wrote last time
+// are available and can be read back without stalling before their range is reset
+void VulkanInstance::resolveTimestamps(vk::CommandBuffer commandBuffer) {
+  if (!_timestampPool) {
+    return;
+  }
+
+  uint32_t firstQuery = _currentFrame * MAX_GPU_TIMESTAMP_PASSES * 2;
+  std::vector<std::string>& passNames = _timestampPassNames[_currentFrame];
+
+  // left empty when nothing was timed or the results are not available, never the previous frame's
+  _gpuPassTimes.clear();
+  if (!passNames.empty()) {
+    std::vector<uint64_t> timestamps(passNames.size() * 2);
+    vk::Result result = _device.getQueryPoolResults(
+        _timestampPool, 
+        firstQuery, 
+        static_cast<uint32_t>(timestamps.size()), 
+        timestamps.size() * sizeof(uint64_t), 
+        timestamps.data(), 
+        sizeof(uint64_t), 
+        vk::QueryResultFlagBits::e64
+        );
+
+    if (result == vk::Result::eSuccess) {
+      for (size_t i = 0; i < passNames.size(); i++) {
+        uint64_t ticks = ((timestamps[i * 2 + 1] & _timestampMask) - (timestamps[i * 2] & _timestampMask)) & _timestampMask;
+        _gpuPassTimes.push_back({ passNames[i], static_cast<double>(ticks) * _timestampPeriod / 1000000.0 });
+      }
+    }
+    passNames.clear();
+  }
+
+  commandBuffer.resetQueryPool(_timestampPool, firstQuery, MAX_GPU_TIMESTAMP_PASSES * 2);
+}
+
 void VulkanInstance::cleanupSwapChain() {
   _device.waitIdle();
 
@@ -453,7 +767,18 @@ void VulkanInstance::cleanupSwapChain() {
     _device.destroyImageView(_swapChainImageViews[i]);
   }
 
-  _device.destroySwapchainKHR(_swapChain);
+  if (_headless) {
+    cleanupOffscreenImages();
+  } else {
+    _device.destroySwapchainKHR(_swapChain);
+  }
+}
+
+void VulkanInstance::cleanupOffscreenImages() {
+  for (size_t i = 0; i < _swapChainImages.size(); i++) {
+    _device.destroyImage(_swapChainImages[i]);
+    _device.freeMemory(_offscreenMemories[i]);
+  }
 }
 
 void VulkanInstance::cleanupRenderPass() {
@@ -461,23 +786,36 @@ void VulkanInstance::cleanupRenderPass() {
 }
 
 void VulkanInstance::cleanupSyncObjects() {
-  for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+  for (size_t i = 0; i < _framesInFlight; i++) {
     _device.destroySemaphore(_imageAvailableSemaphores[i]);
     _device.destroySemaphore(_renderFinishedSemaphores[i]);
     _device.destroyFence(_inFlightFences[i]);
   }
 }
 
+void VulkanInstance::cleanupTimestampQueryPool() {
+  if (_timestampPool) {
+    _device.destroyQueryPool(_timestampPool);
+  }
+}
+
 void VulkanInstance::cleanupCommandPool() {
   _device.destroyCommandPool(_commandPool);
+  for (auto& frameCommands : _frameCommands) {
+    _device.destroyCommandPool(frameCommands.pool);
+  }
+  _frameCommands.clear();
 }
 
 void VulkanInstance::cleanupLogicalDevice() {
   _device.destroy();
+  _drawIndexedIndirectCount = nullptr;
 }
 
 void VulkanInstance::cleanupSurface() {
-  _instance.destroySurfaceKHR(_surface);
+  if (_surface) {
+    _instance.destroySurfaceKHR(_surface);
+  }
 }
 
 void VulkanInstance::cleanupInstance() {
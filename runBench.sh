@@ -0,0 +1 @@
+cd ./build && ninja && ./reimp-bench "$@"
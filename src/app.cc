@@ -55,6 +55,7 @@ namespace myWindow {
     }
   }
   void MainWindow::cleanup() {
+    _renderer->cleanup();
     _assets->cleanup();
     _vkInstance->cleanup();
     glfwDestroyWindow(_window);